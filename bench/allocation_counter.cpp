@@ -0,0 +1,31 @@
+/**
+ * @file allocation_counter.cpp
+ *
+ * @brief replaces the global operator new and delete by malloc and free, counting the allocations
+ */
+#include <atomic>
+#include <cstdlib>
+#include <new>
+#include "allocation_counter.hpp"
+
+// counts every call of the global operator new of this program
+static std::atomic<std::size_t> allocations(0);
+
+std::size_t allocation_count() {
+    return allocations.load();
+}
+
+void *operator new(std::size_t size) {
+    allocations++;
+    if (void *ptr = std::malloc(size ? size : 1))
+        return ptr;
+    throw std::bad_alloc();
+}
+
+void operator delete(void *ptr) noexcept {
+    std::free(ptr);
+}
+
+void operator delete(void *ptr, std::size_t) noexcept {
+    std::free(ptr);
+}
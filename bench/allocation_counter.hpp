@@ -0,0 +1,17 @@
+/**
+ * @file allocation_counter.hpp
+ *
+ * @brief counts the calls of the global operator new of the benchmarks. The replacements of operator new
+ * and delete live in allocation_counter.cpp, so the compiler never sees them inlined next to each other.
+ */
+#ifndef BRANCHANDBOUNDTSP_ALLOCATION_COUNTER_HPP
+#define BRANCHANDBOUNDTSP_ALLOCATION_COUNTER_HPP
+
+#include <cstddef>
+
+/**
+ * @return number of calls of the global operator new so far
+ */
+std::size_t allocation_count();
+
+#endif //BRANCHANDBOUNDTSP_ALLOCATION_COUNTER_HPP
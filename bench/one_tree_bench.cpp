@@ -0,0 +1,92 @@
+/**
+ * @file one_tree_bench.cpp
+ *
+ * @brief times the minimum 1-tree computation of every OneTreeEngine on a given instance and checks that
+ * neither it nor the subgradient loop of a child node allocates once the workspace is set up
+ */
+#include <iostream>
+#include <cstring>
+#include <chrono>
+#include <random>
+#include "../header/tsp.hpp"
+#include "allocation_counter.hpp"
+
+/**
+ * computes @p repetitions 1-trees with the given engine and random multipliers
+ * @param allocs number of allocations during the timed repetitions
+ * @return milliseconds per 1-tree
+ */
+double bench_engine(const TSP::Instance<double, double> &tsp, TSP::OneTreeEngine engine,
+                    size_t repetitions, double &weight, size_t &allocs) {
+    size_t n = tsp.size();
+    std::vector<TSP::Node> no_required(n);
+    TSP::EdgeStatus no_constraints(tsp.num_edges());
+    std::vector<double> lambda(n, 0);
+    std::mt19937 gen(42);
+    std::uniform_real_distribution<double> dist(-10., 10.);
+
+    weight = 0;
+    TSP::OneTree tree(n);
+    // warm up, sets up the workspace of this thread
+    TSP::compute_minimal_1_tree(tree, lambda, tsp, no_constraints, no_required, engine);
+    size_t allocs_before = allocation_count();
+    auto begin = std::chrono::steady_clock::now();
+    for (size_t rep = 0; rep < repetitions; rep++) {
+        for (auto &el : lambda)
+            el = dist(gen);
+        tree.clear();
+        TSP::compute_minimal_1_tree(tree, lambda, tsp, no_constraints, no_required, engine);
+        tree.for_each_edge([&](TSP::NodeId i, TSP::NodeId j) { weight += tsp.weight(i, j); });
+    }
+    auto end = std::chrono::steady_clock::now();
+    allocs = allocation_count() - allocs_before;
+    return std::chrono::duration<double, std::milli>(end - begin).count() / repetitions;
+}
+
+int main(int argc, char *argv[]) {
+    if (argc < 3 || strcmp(argv[1], "--instance") != 0) {
+        std::cerr << "Execute like ./one_tree_bench --instance ./dir_to_instance.tsp [--repetitions R]" << std::endl;
+        return EXIT_FAILURE;
+    }
+    size_t repetitions = 20;
+    if (argc > 4 && strcmp(argv[3], "--repetitions") == 0)
+        repetitions = std::max(1, std::atoi(argv[4]));
+
+    TSP::Instance<double, double> tsp(argv[2]);
+    std::cout << "relax/argmin kernel: " << TSP::simd::kernel_name() << std::endl;
+    const std::pair<const char *, TSP::OneTreeEngine> engines[] = {
+        {"dense", TSP::OneTreeEngine::dense},
+        {"heap", TSP::OneTreeEngine::heap}
+    };
+    bool allocation_free = true;
+    for (const auto &el : engines) {
+        double weight = 0;
+        size_t allocs = 0;
+        double ms = bench_engine(tsp, el.second, repetitions, weight, allocs);
+        std::cout << el.first << ": " << ms << " ms per 1-tree (n = " << tsp.size()
+                  << ", checksum " << weight << ", " << allocs << " allocations)" << std::endl;
+        allocation_free = allocation_free && allocs == 0;
+    }
+
+    // the subgradient loop of a child node, i.e. Held_Karp without the root's candidate graph
+    TSP::Constraints constraints(tsp.size());
+    TSP::OneTree tree(tsp.size());
+    TSP::BranchingNode<double, double> root(tsp, constraints, tree);
+    std::vector<double> lambda(root.get_lambda());
+    TSP::AscentState state;
+    TSP::Held_Karp(tsp, lambda, state, tree, constraints);
+    size_t allocs_before = allocation_count();
+    auto begin = std::chrono::steady_clock::now();
+    double bound = TSP::Held_Karp(tsp, lambda, state, tree, constraints);
+    auto end = std::chrono::steady_clock::now();
+    size_t allocs = allocation_count() - allocs_before;
+    std::cout << "Held_Karp: " << std::chrono::duration<double, std::milli>(end - begin).count()
+              << " ms per child bound (bound " << bound << ", " << allocs << " allocations)" << std::endl;
+    allocation_free = allocation_free && allocs == 0;
+
+    if (!allocation_free) {
+        std::cerr << "steady state is not allocation free" << std::endl;
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,232 @@
+/**
+ * @file checkpoint.hpp
+ *
+ * @brief Checkpoints of the branch and bound search: the best tour, the multipliers of the root and all
+ * open nodes in compact form. They are written by a background thread, so the search only pauses for
+ * taking a snapshot of its open nodes, which copies no node data.
+ */
+#ifndef BRANCHANDBOUNDTSP_CHECKPOINT_HPP
+#define BRANCHANDBOUNDTSP_CHECKPOINT_HPP
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+#include "util.hpp"
+#include "spill.hpp"
+
+namespace TSP {
+using size_type = std::size_t;
+using EdgeId = size_type;
+
+/**
+ * @class Checkpoint
+ * The state of a search from which it can be continued. The file starts with a magic string, the
+ * dimension, the upper bound, the tour and the multipliers of the root, followed by the open nodes,
+ * each of them as its length and the bytes written by T::save().
+ * @tparam T node type, see SpillingQueue
+ * @tparam dist_type
+ */
+template<class T, class dist_type>
+struct Checkpoint {
+  size_type dimension = 0;
+  /// length of tour, max() if there is none yet
+  dist_type upper_bound = std::numeric_limits<dist_type>::max();
+  std::vector<EdgeId> tour;
+  std::vector<double> root_lambda;
+  /// open nodes in memory, shared with the search
+  std::vector<T> nodes;
+  /// open nodes in spill files
+  std::vector<SpilledRecords> spilled;
+
+  /**
+   * writes the checkpoint to filename + ".tmp" first and renames it, so an existing checkpoint is only
+   * replaced by a complete one
+   * @param filename
+   */
+  void write(const std::string &filename) const {
+      const std::string tmp = filename + ".tmp";
+      {
+          std::ofstream out(tmp, std::ios::binary | std::ios::trunc);
+          if (!out.is_open())
+              throw std::runtime_error("File " + tmp + " could not be opened");
+          out.write(magic, sizeof(magic));
+          write_binary(out, std::uint64_t(dimension));
+          write_binary(out, upper_bound);
+          write_binary(out, std::uint64_t(tour.size()));
+          for (const auto &el : tour)
+              write_binary(out, std::uint64_t(el));
+          write_binary(out, std::uint64_t(root_lambda.size()));
+          for (const auto &el : root_lambda)
+              write_binary(out, el);
+          std::uint64_t num_nodes = nodes.size();
+          for (const auto &el : spilled)
+              num_nodes += el.size();
+          write_binary(out, num_nodes);
+          std::string data;
+          auto write_node = [&]() {
+              write_binary(out, std::uint64_t(data.size()));
+              out.write(data.data(), data.size());
+          };
+          for (const auto &el : nodes) {
+              std::ostringstream node;
+              el.save(node);
+              data = node.str();
+              write_node();
+          }
+          for (const auto &el : spilled) {
+              for (size_type i = 0; i < el.size(); i++) {
+                  el.read(i, data);
+                  write_node();
+              }
+          }
+          if (!out.flush())
+              throw std::runtime_error("File " + tmp + " could not be written");
+      }
+      if (std::rename(tmp.c_str(), filename.c_str()) != 0)
+          throw std::runtime_error("File " + tmp + " could not be renamed to " + filename);
+  }
+
+  /**
+   * reads a checkpoint written by write()
+   * @param filename
+   * @param dimension number of nodes of the instance, the nodes are read by T(std::istream &, dimension)
+   * @param on_node called with every open node, which is moved from afterwards
+   * @return the checkpoint without the nodes
+   * @throws std::runtime_error if the file is no checkpoint of an instance with dimension nodes
+   */
+  template<class Function>
+  static Checkpoint read(const std::string &filename, size_type dimension, Function on_node) {
+      std::ifstream in(filename, std::ios::binary);
+      if (!in.is_open())
+          throw std::runtime_error("File " + filename + " could not be opened");
+      char header[sizeof(magic)];
+      if (!in.read(header, sizeof(header)) || std::memcmp(header, magic, sizeof(magic)) != 0)
+          throw std::runtime_error("File " + filename + " is no checkpoint");
+      Checkpoint checkpoint;
+      std::uint64_t value = 0;
+      read_binary(in, value);
+      checkpoint.dimension = value;
+      if (value != dimension)
+          throw std::runtime_error("Checkpoint " + filename + " has dimension " + std::to_string(value)
+                                       + ", but the instance " + std::to_string(dimension));
+      read_binary(in, checkpoint.upper_bound);
+      read_binary(in, value);
+      if (value != 0 && value != dimension)
+          throw std::runtime_error("Checkpoint " + filename + " has a tour of " + std::to_string(value) + " edges");
+      checkpoint.tour.resize(value);
+      for (auto &el : checkpoint.tour) {
+          read_binary(in, value);
+          if (value >= dimension * (dimension - 1) / 2)
+              throw std::runtime_error("Checkpoint " + filename + " has a tour on edge " + std::to_string(value));
+          el = value;
+      }
+      read_binary(in, value);
+      if (value != 0 && value != dimension)
+          throw std::runtime_error("Checkpoint " + filename + " has " + std::to_string(value)
+                                       + " root multipliers");
+      checkpoint.root_lambda.resize(value);
+      for (auto &el : checkpoint.root_lambda)
+          read_binary(in, el);
+      std::uint64_t num_nodes = 0;
+      read_binary(in, num_nodes);
+      std::string data;
+      for (std::uint64_t i = 0; i < num_nodes; i++) {
+          read_binary(in, value);
+          data.resize(value);
+          if (!in.read(&data[0], data.size()))
+              throw std::runtime_error("File " + filename + " ends within a node");
+          std::istringstream node(data);
+          T el(node, dimension);
+          on_node(std::move(el));
+      }
+      return checkpoint;
+  }
+
+ private:
+  static constexpr char magic[8] = {'B', 'B', 'T', 'S', 'P', 'C', 'K', '2'};
+};
+
+template<class T, class dist_type>
+constexpr char Checkpoint<T, dist_type>::magic[8];
+
+/**
+ * @class CheckpointWriter
+ * Writes one checkpoint at a time in a background thread. Errors are reported on std::cerr, they do
+ * not stop the search.
+ * @tparam T node type
+ * @tparam dist_type
+ */
+template<class T, class dist_type>
+class CheckpointWriter {
+ public:
+  /**
+   * @param filename where the checkpoints are written, empty for none
+   * @param interval seconds between two checkpoints
+   */
+  CheckpointWriter(const std::string &filename, double interval)
+      : _filename(filename), _interval(interval), _last(std::chrono::steady_clock::now()), _busy(false) {}
+
+  CheckpointWriter(const CheckpointWriter &) = delete;
+  CheckpointWriter &operator=(const CheckpointWriter &) = delete;
+
+  ~CheckpointWriter() {
+      wait();
+  }
+
+  /**
+   * @return true, if a checkpoint should be taken now: the interval passed and the last one is written
+   */
+  bool due() const {
+      return !_filename.empty() && !_busy.load()
+          && std::chrono::duration<double>(std::chrono::steady_clock::now() - _last).count() >= _interval;
+  }
+
+  /**
+   * writes the checkpoint in the background
+   */
+  void start(Checkpoint<T, dist_type> &&checkpoint) {
+      wait();
+      _last = std::chrono::steady_clock::now();
+      _busy.store(true);
+      _thread = std::thread([this](Checkpoint<T, dist_type> state) {
+          try {
+              state.write(_filename);
+          }
+          catch (const std::exception &e) {
+              std::cerr << "Checkpoint failed: " << e.what() << std::endl;
+          }
+          _busy.store(false);
+      }, std::move(checkpoint));
+  }
+
+  /**
+   * waits until the checkpoint being written, if any, is complete
+   */
+  void wait() {
+      if (_thread.joinable())
+          _thread.join();
+  }
+
+ private:
+  std::string _filename;
+  double _interval;
+  std::chrono::steady_clock::time_point _last;
+  std::atomic<bool> _busy;
+  std::thread _thread;
+};
+
+}
+
+#endif //BRANCHANDBOUNDTSP_CHECKPOINT_HPP
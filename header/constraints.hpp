@@ -0,0 +1,341 @@
+/**
+ * @file constraints.hpp
+ *
+ * @brief Definition of the Constraints class, i.e. the required and forbidden edges of a BranchingNode,
+ * and of the DecisionList a BranchingNode stores them as
+ */
+#ifndef BRANCHANDBOUNDTSP_CONSTRAINTS_HPP
+#define BRANCHANDBOUNDTSP_CONSTRAINTS_HPP
+
+#include <cassert>
+#include <cstdlib>
+#include <memory>
+#include <utility>
+#include <vector>
+#include "graph.hpp"
+#include "util.hpp"
+#include "edge_status.hpp"
+
+namespace TSP {
+using size_type = std::size_t;
+using NodeId = size_type;
+using EdgeId = size_type;
+
+/**
+ * one edge that became required or forbidden
+ */
+typedef std::pair<EdgeId, EdgeStatus::Status> Decision;
+
+/**
+ * The decisions of one BranchingNode on top of those of its parent. The lists of a path in the B'n'B
+ * tree share their common part, so a node only costs its own decisions.
+ */
+struct DecisionList {
+  std::shared_ptr<const DecisionList> parent;
+  std::vector<Decision> decisions;
+};
+
+/**
+ * @class Constraints
+ * All required and forbidden edges of a BranchingNode. Requiring or forbidding an edge implies further
+ * decisions: a node with two required edges gets all others forbidden, a node with n-3 forbidden edges
+ * gets the remaining ones required and the edge joining the two ends of a path of required edges is
+ * forbidden, unless the path visits all nodes and the edge closes the tour. If a log is set, every
+ * decision is appended to it. Decisions which contradict the others make the constraints infeasible().
+ */
+class Constraints {
+ public:
+  /**
+   * @param size number of nodes, all edges are free
+   */
+  Constraints(size_type size)
+      : _size(size), _status(size * (size - 1) / 2), _required_neighbors(size), _forbidden_degree(size, 0),
+        _log(nullptr), _path_parent(size), _path_size(size), _path_ends(size) {
+      reset();
+  }
+
+  /**
+   * frees all edges, keeps the memory of the neighbor lists
+   */
+  void reset() {
+      _status.clear();
+      for (auto &el : _required_neighbors)
+          el.clear();
+      std::fill(_forbidden_degree.begin(), _forbidden_degree.end(), 0);
+      for (NodeId v = 0; v < _size; v++) {
+          _path_parent[v] = v;
+          _path_size[v] = 1;
+          _path_ends[v] = std::make_pair(v, v);
+      }
+      _joins.clear();
+      _infeasible = false;
+  }
+
+  /**
+   * resets and applies the decisions of @p list and all its ancestors, oldest first. They are not logged.
+   */
+  void replay(const DecisionList *list) {
+      std::vector<Decision> *log = _log;
+      _log = nullptr;
+      reset();
+      _path.clear();
+      for (; list; list = list->parent.get())
+          _path.push_back(list);
+      for (auto it = _path.rbegin(); it != _path.rend(); ++it)
+          for (const auto &el : (*it)->decisions) {
+              if (el.second == EdgeStatus::REQUIRED)
+                  push_required(el.first);
+              else
+                  push_forbidden(el.first);
+          }
+      _path.clear();
+      _log = log;
+  }
+
+  /**
+   * takes back @p decisions, which have to be the latest ones applied, newest first. Together with a
+   * log this lets a caller try the decisions of several children on one Constraints. The constraints
+   * before them have to be feasible, they are so again afterwards.
+   */
+  void undo(const std::vector<Decision> &decisions) {
+      for (auto it = decisions.rbegin(); it != decisions.rend(); ++it) {
+          NodeId i = 0, j = 0;
+          to_NodeId(it->first, i, j, _size);
+          assert(_status.get(it->first) == it->second);
+          _status.set(it->first, EdgeStatus::FREE);
+          if (it->second == EdgeStatus::REQUIRED) {
+              _required_neighbors[i].remove_neighbor(j);
+              _required_neighbors[j].remove_neighbor(i);
+              split();
+          } else {
+              _forbidden_degree[i]--;
+              _forbidden_degree[j]--;
+          }
+      }
+      _infeasible = false;
+  }
+
+  /**
+   * @param log where the decisions are appended from now on, nullptr for none
+   */
+  void set_log(std::vector<Decision> *log) {
+      _log = log;
+  }
+
+  bool is_required(EdgeId e) const {
+      return _status.is_required(e);
+  }
+  bool is_forbidden(EdgeId e) const {
+      return _status.is_forbidden(e);
+  }
+
+  /**
+   * requires e and everything implied by it. If e is forbidden, one of its end nodes has two required
+   * edges already or e closes a cycle of required edges which is no tour, the constraints become
+   * infeasible instead.
+   */
+  void add_required(EdgeId e) {
+      if (_infeasible || is_required(e))
+          return;
+      NodeId i = 0, j = 0;
+      to_NodeId(e, i, j, _size);
+      NodeId root = find_path(i);
+      if (is_forbidden(e) || _required_neighbors.at(i).degree() == 2 || _required_neighbors.at(j).degree() == 2
+          || (root == find_path(j) && _path_size[root] < _size)) {
+          _infeasible = true;
+          return;
+      }
+      push_required(e);
+
+      if (_required_neighbors.at(i).degree() == 2)
+          forbid(i, to_EdgeId(i, _required_neighbors.at(i).neighbors().at(0), _size),
+                 to_EdgeId(i, _required_neighbors.at(i).neighbors().at(1), _size));
+      if (_required_neighbors.at(j).degree() == 2)
+          forbid(j, to_EdgeId(j, _required_neighbors.at(j).neighbors().at(0), _size),
+                 to_EdgeId(j, _required_neighbors.at(j).neighbors().at(1), _size));
+      // the ends of the path of e may only be joined by the edge closing the tour
+      root = find_path(i);
+      NodeId first = _path_ends[root].first, second = _path_ends[root].second;
+      if (_infeasible || _path_size[root] < 3)
+          return;
+      if (_path_size[root] < _size)
+          add_forbidden(to_EdgeId(first, second, _size));
+      else
+          add_required(to_EdgeId(first, second, _size));
+  }
+
+  /**
+   * forbids e and everything implied by it. If e is required, the constraints become infeasible instead.
+   */
+  void add_forbidden(EdgeId e) {
+      if (_infeasible || is_forbidden(e))
+          return;
+      if (is_required(e)) {
+          _infeasible = true;
+          return;
+      }
+      push_forbidden(e);
+      NodeId i = 0, j = 0;
+      to_NodeId(e, i, j, _size);
+
+      if (_forbidden_degree.at(i) == _size - 3)
+          admit(i);
+      if (_forbidden_degree.at(j) == _size - 3)
+          admit(j);
+  }
+
+  /**
+   * @return true, if a decision since the last replay() or undo() contradicted the others, i.e. no tour
+   * respects the constraints. The contradicting decision and its implications were not applied.
+   */
+  bool infeasible() const {
+      return _infeasible;
+  }
+
+  //getter functions
+  size_type size() const {
+      return _size;
+  }
+  const EdgeStatus &status() const {
+      return _status;
+  }
+  const std::vector<Node> &required_neighbors() const {
+      return _required_neighbors;
+  }
+
+ private:
+  /**
+   * forbids all edges incident to idx but e1 and e2
+   */
+  void forbid(NodeId idx, EdgeId e1, EdgeId e2) {
+      for (NodeId k = 0; k < _size; k++) {
+          if (idx != k) {
+              EdgeId edge = to_EdgeId(idx, k, _size);
+              if (edge != e1 && edge != e2)
+                  add_forbidden(edge);
+          }
+      }
+  }
+
+  /**
+   * requires all edges incident to idx which are not forbidden
+   */
+  void admit(NodeId idx) {
+      for (NodeId k = 0; k < _size; k++) {
+          if (idx != k) {
+              EdgeId edge = to_EdgeId(idx, k, _size);
+              if (!is_forbidden(edge))
+                  add_required(edge);
+          }
+      }
+  }
+
+  /**
+   * marks e as required and updates the required neighbors and paths, nothing else
+   * @return false, if e was required already
+   */
+  bool push_required(EdgeId e) {
+      if (is_required(e))
+          return false;
+      assert(!is_forbidden(e));
+      NodeId i = 0, j = 0;
+      to_NodeId(e, i, j, _size);
+      _status.set(e, EdgeStatus::REQUIRED);
+      _required_neighbors.at(i).add_neighbor(j);
+      _required_neighbors.at(j).add_neighbor(i);
+      join(i, j);
+      if (_log)
+          _log->push_back(Decision(e, EdgeStatus::REQUIRED));
+      return true;
+  }
+
+  /**
+   * @return the representative of the path of required edges containing v
+   */
+  NodeId find_path(NodeId v) const {
+      while (_path_parent[v] != v)
+          v = _path_parent[v];
+      return v;
+  }
+
+  /**
+   * joins the paths ending in i and j by union by size. There is no path compression, so split() can
+   * take the latest join back.
+   */
+  void join(NodeId i, NodeId j) {
+      NodeId root_i = find_path(i), root_j = find_path(j);
+      if (root_i == root_j) { // closes the tour
+          _joins.push_back(Join{_size, _path_ends[root_i]});
+          return;
+      }
+      auto other_end = [&](NodeId root, NodeId v) {
+          return _path_ends[root].first == v ? _path_ends[root].second : _path_ends[root].first;
+      };
+      std::pair<NodeId, NodeId> ends(other_end(root_i, i), other_end(root_j, j));
+      if (_path_size[root_i] < _path_size[root_j])
+          std::swap(root_i, root_j);
+      _joins.push_back(Join{root_j, _path_ends[root_i]});
+      _path_parent[root_j] = root_i;
+      _path_size[root_i] += _path_size[root_j];
+      _path_ends[root_i] = ends;
+  }
+
+  /**
+   * takes back the latest join()
+   */
+  void split() {
+      assert(!_joins.empty());
+      Join last = _joins.back();
+      _joins.pop_back();
+      if (last.child == _size)
+          return;
+      NodeId root = _path_parent[last.child];
+      _path_parent[last.child] = last.child;
+      _path_size[root] -= _path_size[last.child];
+      _path_ends[root] = last.ends;
+  }
+
+  /**
+   * marks e as forbidden and updates the forbidden degrees, nothing else
+   * @return false, if e was forbidden already
+   */
+  bool push_forbidden(EdgeId e) {
+      if (is_forbidden(e))
+          return false;
+      assert(!is_required(e));
+      NodeId i = 0, j = 0;
+      to_NodeId(e, i, j, _size);
+      _status.set(e, EdgeStatus::FORBIDDEN);
+      _forbidden_degree[i]++;
+      _forbidden_degree[j]++;
+      if (_log)
+          _log->push_back(Decision(e, EdgeStatus::FORBIDDEN));
+      return true;
+  }
+
+  size_type _size;
+  EdgeStatus _status;
+  std::vector<Node> _required_neighbors;
+  // number of forbidden edges incident to each node
+  std::vector<size_type> _forbidden_degree;
+  std::vector<Decision> *_log;
+  // scratch space of replay
+  std::vector<const DecisionList *> _path;
+
+  // one join() per required edge: the representative attached to another one (_size if none) and the
+  // ends of the other one before
+  struct Join {
+    NodeId child;
+    std::pair<NodeId, NodeId> ends;
+  };
+  // the paths of required edges as a union-find forest, size and ends are those of the representatives
+  std::vector<NodeId> _path_parent;
+  std::vector<size_type> _path_size;
+  std::vector<std::pair<NodeId, NodeId> > _path_ends;
+  std::vector<Join> _joins;
+  bool _infeasible = false;
+};
+
+}
+
+#endif //BRANCHANDBOUNDTSP_CONSTRAINTS_HPP
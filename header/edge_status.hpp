@@ -0,0 +1,95 @@
+/**
+ * @file edge_status.hpp
+ *
+ * @brief Definition of the EdgeStatus class, which tells in O(1) whether an edge is required, forbidden
+ * or neither
+ */
+#ifndef BRANCHANDBOUNDTSP_EDGE_STATUS_HPP
+#define BRANCHANDBOUNDTSP_EDGE_STATUS_HPP
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <memory>
+#include <vector>
+
+namespace TSP {
+using size_type = std::size_t;
+using EdgeId = size_type;
+
+/**
+ * @class EdgeStatus
+ * Two bits per EdgeId, i.e. n(n-1)/4 bytes for n nodes. Copies share the bits with the original until
+ * one of them is changed (copy on write), so copying a BranchingNode does not copy them.
+ */
+class EdgeStatus {
+ public:
+  enum Status : std::uint64_t { FREE = 0, REQUIRED = 1, FORBIDDEN = 2 };
+
+  /**
+   * @param num_edges number of EdgeIds, all of them FREE
+   */
+  EdgeStatus(size_type num_edges)
+      : _words(std::make_shared<std::vector<std::uint64_t> >((num_edges + EDGES_PER_WORD - 1) / EDGES_PER_WORD, 0)) {}
+
+  Status get(EdgeId e) const {
+      return static_cast<Status>(((*_words)[e / EDGES_PER_WORD] >> shift(e)) & 3);
+  }
+
+  bool is_required(EdgeId e) const {
+      return get(e) == REQUIRED;
+  }
+  bool is_forbidden(EdgeId e) const {
+      return get(e) == FORBIDDEN;
+  }
+
+  void set(EdgeId e, Status status) {
+      if (_words.use_count() > 1) // somebody else still looks at these bits
+          _words = std::make_shared<std::vector<std::uint64_t> >(*_words);
+      std::uint64_t &word = (*_words)[e / EDGES_PER_WORD];
+      word = (word & ~(std::uint64_t(3) << shift(e))) | (std::uint64_t(status) << shift(e));
+  }
+
+  /**
+   * sets all edges FREE
+   */
+  void clear() {
+      if (_words.use_count() > 1)
+          _words = std::make_shared<std::vector<std::uint64_t> >(_words->size(), 0);
+      else
+          std::fill(_words->begin(), _words->end(), 0);
+  }
+
+  /**
+   * calls f(e, status) for every EdgeId e in [begin, end) which is not FREE, in increasing order.
+   * Skips whole words of free edges, so scanning a row of the upper triangle is cheap.
+   */
+  template<class Function>
+  void for_each_constrained(EdgeId begin, EdgeId end, Function f) const {
+      EdgeId e = begin;
+      while (e < end) {
+          std::uint64_t word = (*_words)[e / EDGES_PER_WORD] >> shift(e);
+          if (word == 0) {
+              e = (e / EDGES_PER_WORD + 1) * EDGES_PER_WORD;
+              continue;
+          }
+          e += __builtin_ctzll(word) / 2;
+          if (e < end)
+              f(e, get(e));
+          e++;
+      }
+  }
+
+ private:
+  static const size_type EDGES_PER_WORD = 32;
+
+  static unsigned shift(EdgeId e) {
+      return static_cast<unsigned>(2 * (e % EDGES_PER_WORD));
+  }
+
+  std::shared_ptr<std::vector<std::uint64_t> > _words;
+};
+
+}
+
+#endif //BRANCHANDBOUNDTSP_EDGE_STATUS_HPP
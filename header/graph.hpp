@@ -51,6 +51,13 @@ class Node {
      @warning Does not check whether @c id is the identity of the node itself (which would create a loop!).
   **/
   void add_neighbor(NodeId const id);
+  /**
+     @brief Removes the last occurrence of @c id from the list of neighbors, the order of the others is kept.
+     @warning Does not check whether @c id is in the list of neighbors at all.
+  **/
+  void remove_neighbor(NodeId const id);
+  /** @brief Removes all neighbors, keeps the memory. **/
+  void clear();
  private:
   friend class OneTree;
   friend class BranchingTree;
@@ -70,6 +77,11 @@ std::vector<NodeId> const &Node::neighbors() const {
     return _neighbors;
 }
 
+inline
+void Node::clear() {
+    _neighbors.clear();
+}
+
 
 
 
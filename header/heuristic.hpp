@@ -0,0 +1,754 @@
+/**
+ * @file heuristic.hpp
+ *
+ * @brief Primal heuristics: a greedy tour improved by 2-opt and Or-opt. Their tour is the upper bound
+ * the branch and bound starts with. Once the root is bounded, Lin-Kernighan steps on the alpha-nearness
+ * candidates of its 1-tree improve it further.
+ */
+#ifndef BRANCHANDBOUNDTSP_HEURISTIC_HPP
+#define BRANCHANDBOUNDTSP_HEURISTIC_HPP
+
+#include <cassert>
+#include <cstdlib>
+#include <algorithm>
+#include <numeric>
+#include <random>
+#include <utility>
+#include <vector>
+#include "util.hpp"
+#include "tree.hpp"
+#include "kdtree.hpp"
+#include "constraints.hpp"
+
+namespace TSP {
+using size_type = std::size_t;
+using NodeId = size_type;
+using EdgeId = size_type;
+
+template<class coord_type, class dist_type>
+class Instance;
+
+/**
+ * @param tsp The TSP Instance
+ * @param k number of neighbors per node
+ * @return the k nearest neighbors of every node, ordered by distance
+ */
+template<class coord_type, class dist_type>
+std::vector<std::vector<NodeId> > nearest_neighbor_lists(const Instance<coord_type, dist_type> &tsp, size_type k) {
+    std::vector<std::vector<NodeId> > neighbors(tsp.size());
+    for (NodeId i = 0; i < tsp.size(); i++)
+        neighbors[i] = tsp.spatial_index().nearest(i, std::min(k, tsp.size() - 1));
+    return neighbors;
+}
+
+/**
+ * @return the length of the tour visiting the nodes in the given order
+ */
+template<class coord_type, class dist_type>
+dist_type tour_length(const Instance<coord_type, dist_type> &tsp, const std::vector<NodeId> &order) {
+    dist_type length = 0;
+    for (size_type i = 0; i < order.size(); i++)
+        length += tsp.weight(order[i], order[(i + 1) % order.size()]);
+    return length;
+}
+
+/**
+ * @return the edges of the tour visiting the nodes in the given order as EdgeIds
+ */
+inline std::vector<EdgeId> tour_edges(const std::vector<NodeId> &order) {
+    std::vector<EdgeId> edges;
+    for (size_type i = 0; i < order.size(); i++)
+        edges.push_back(to_EdgeId(order[i], order[(i + 1) % order.size()], order.size()));
+    return edges;
+}
+
+/**
+ * @param edges the edges of a tour as EdgeIds
+ * @param n number of nodes
+ * @return the order in which the tour visits the nodes, starting at node 0
+ */
+inline std::vector<NodeId> tour_order(const std::vector<EdgeId> &edges, size_type n) {
+    std::vector<NodeId> adjacent(2 * n, n);
+    for (EdgeId e : edges) {
+        NodeId i = 0, j = 0;
+        to_NodeId(e, i, j, n);
+        adjacent[2 * i + (adjacent[2 * i] != n)] = j;
+        adjacent[2 * j + (adjacent[2 * j] != n)] = i;
+    }
+    std::vector<NodeId> order;
+    order.reserve(n);
+    NodeId previous = n, v = 0;
+    for (size_type i = 0; i < n; i++) {
+        order.push_back(v);
+        NodeId next = adjacent[2 * v] != previous ? adjacent[2 * v] : adjacent[2 * v + 1];
+        previous = v;
+        v = next;
+    }
+    return order;
+}
+
+/**
+ * Alpha-nearness of an edge {i,j} is the increase of the minimum 1-tree if it has to contain {i,j}: its
+ * modified weight minus the largest one on the path from i to j in the spanning tree, or minus the
+ * larger edge at node 0 for the edges {0,j}. Edges of the 1-tree have alpha 0. The optimal edges tend to
+ * have small alpha, far more so than they tend to be short. Takes O(n^2) time and O(n) space.
+ * @param tsp The TSP Instance
+ * @param tree a minimum 1-tree for lambda, e.g. the one of the root
+ * @param lambda
+ * @param f called for every node i with the alpha(i,j) and the weights c(i,j), both indexed by j.
+ * Entry i of both is garbage.
+ */
+template<class coord_type, class dist_type, class Function>
+void alpha_nearness(const Instance<coord_type, dist_type> &tsp,
+                    const OneTree &tree,
+                    const std::vector<double> &lambda,
+                    Function f) {
+    const size_type n = tsp.size();
+    const NodeId none = OneTree::none;
+    // the spanning tree on {1,..,n-1} in breadth-first order, every parent before its children
+    std::vector<NodeId> first_child(n, none), next_sibling(n, none), order;
+    for (NodeId v = 2; v < n; v++) {
+        next_sibling[v] = first_child[tree.parent(v)];
+        first_child[tree.parent(v)] = v;
+    }
+    order.reserve(n - 1);
+    order.push_back(1);
+    for (size_type pos = 0; pos < order.size(); pos++)
+        for (NodeId v = first_child[order[pos]]; v != none; v = next_sibling[v])
+            order.push_back(v);
+    assert(order.size() == n - 1);
+
+    std::vector<dist_type> row(n);
+    std::vector<double> parent_weight(n, 0.);
+    for (NodeId v = 2; v < n; v++)
+        parent_weight[v] = tsp.weight(v, tree.parent(v)) + lambda[v] + lambda[tree.parent(v)];
+    const NodeId *root_neighbors = tree.root_neighbors();
+    const double root_weight = std::max(tsp.weight(0, root_neighbors[0]) + lambda[0] + lambda[root_neighbors[0]],
+                                        tsp.weight(0, root_neighbors[1]) + lambda[0] + lambda[root_neighbors[1]]);
+
+    // beta[j] is the largest modified weight on the path from i to j, mark[j] == i if j is on the path
+    // from i to node 1
+    std::vector<double> beta(n, 0.), alpha(n, 0.);
+    std::vector<NodeId> mark(n, none);
+    for (NodeId i = 0; i < n; i++) {
+        tsp.weight_row(i, row.data());
+        auto modified = [&](NodeId j) {
+            return row[j] + lambda[i] + lambda[j];
+        };
+        if (i == 0) {
+            for (NodeId j = 1; j < n; j++)
+                alpha[j] = std::max(0., modified(j) - root_weight);
+        } else {
+            beta[i] = -std::numeric_limits<double>::infinity();
+            mark[i] = i;
+            for (NodeId v = i; v != 1; v = tree.parent(v)) {
+                beta[tree.parent(v)] = std::max(beta[v], parent_weight[v]);
+                mark[tree.parent(v)] = i;
+            }
+            alpha[0] = std::max(0., modified(0) - root_weight);
+            for (NodeId j : order) {
+                if (j == i)
+                    continue;
+                if (mark[j] != i)
+                    beta[j] = std::max(beta[tree.parent(j)], parent_weight[j]);
+                alpha[j] = std::max(0., modified(j) - beta[j]);
+            }
+        }
+        f(i, alpha, row);
+    }
+}
+
+/**
+ * @param tsp The TSP Instance
+ * @param tree a minimum 1-tree for lambda, e.g. the one of the root
+ * @param lambda
+ * @param k number of candidates per node
+ * @return the k nodes j of smallest alpha(i,j) for every node i, ordered by alpha, ties by weight, see
+ * alpha_nearness()
+ */
+template<class coord_type, class dist_type>
+std::vector<std::vector<NodeId> > alpha_nearness_lists(const Instance<coord_type, dist_type> &tsp,
+                                                       const OneTree &tree,
+                                                       const std::vector<double> &lambda,
+                                                       size_type k) {
+    const size_type n = tsp.size();
+    k = std::min(k, n - 1);
+    std::vector<std::pair<std::pair<double, dist_type>, NodeId> > sorted;
+    sorted.reserve(n - 1);
+    std::vector<std::vector<NodeId> > candidates(n);
+    alpha_nearness(tsp, tree, lambda, [&](NodeId i, const std::vector<double> &alpha,
+                                          const std::vector<dist_type> &row) {
+        sorted.clear();
+        for (NodeId j = 0; j < n; j++)
+            if (j != i)
+                sorted.push_back(std::make_pair(std::make_pair(alpha[j], row[j]), j));
+        std::partial_sort(sorted.begin(), sorted.begin() + k, sorted.end());
+        for (size_type pos = 0; pos < k; pos++)
+            candidates[i].push_back(sorted[pos].second);
+    });
+    return candidates;
+}
+
+/**
+ * @class PathFragments
+ * Node-disjoint paths which are extended edge by edge until they form a tour. Every node knows its at
+ * most two neighbors, the two ends of a path know each other.
+ */
+class PathFragments {
+ public:
+  /**
+   * @param n number of nodes, each of them a path of its own
+   */
+  explicit PathFragments(size_type n) : _n(n), _adjacent(2 * n, n), _other_end(n), _num_edges(0) {
+      std::iota(_other_end.begin(), _other_end.end(), 0);
+  }
+
+  size_type degree(NodeId v) const {
+      return (_adjacent[2 * v] != _n) + (_adjacent[2 * v + 1] != _n);
+  }
+
+  /**
+   * @return true, if v and w are ends of different paths
+   */
+  bool can_link(NodeId v, NodeId w) const {
+      return degree(v) < 2 && degree(w) < 2 && _other_end[v] != w;
+  }
+
+  /**
+   * joins the paths ending in v and w, see can_link()
+   */
+  void link(NodeId v, NodeId w) {
+      _adjacent[2 * v + (_adjacent[2 * v] != _n)] = w;
+      _adjacent[2 * w + (_adjacent[2 * w] != _n)] = v;
+      NodeId v_end = _other_end[v], w_end = _other_end[w];
+      _other_end[v_end] = w_end;
+      _other_end[w_end] = v_end;
+      _num_edges++;
+  }
+
+  /**
+   * joins the paths to a tour: the path of the lowest free end goes on to the nearest free end of
+   * another path, until there is one path left, which is closed
+   * @param index spatial index of the nodes
+   * @param allowed only edges {v,w} with allowed(v, w) are added
+   * @param joined the ends of the added edges are appended here, if it is not nullptr
+   * @return false, if at some point there is no allowed edge to another path. Then the paths are garbage.
+   */
+  template<class coord_type, class Predicate>
+  bool join(const KdTree<coord_type> &index, Predicate allowed, std::vector<NodeId> *joined = nullptr) {
+      if (_n < 3)
+          return false;
+      std::vector<char> free_end(_n, false);
+      for (NodeId v = 0; v < _n; v++)
+          free_end[v] = degree(v) < 2;
+      NodeId start = 0;
+      while (_num_edges + 1 < _n) {
+          while (!free_end[start])
+              start++;
+          NodeId end = _other_end[start];
+          free_end[start] = free_end[end] = false;
+          std::vector<NodeId> next = index.nearest_if(end, 1, [&](NodeId v) {
+              return free_end[v] && allowed(end, v);
+          });
+          if (next.empty())
+              return false;
+          link(end, next.front());
+          free_end[next.front()] = degree(next.front()) < 2;
+          free_end[start] = true;
+          if (joined) {
+              joined->push_back(end);
+              joined->push_back(next.front());
+          }
+      }
+      if (_num_edges == _n)
+          return true;
+      // close the Hamiltonian path
+      start = 0;
+      while (degree(start) == 2)
+          start++;
+      NodeId end = _other_end[start];
+      if (!allowed(start, end))
+          return false;
+      link(start, end);
+      if (joined) {
+          joined->push_back(start);
+          joined->push_back(end);
+      }
+      return true;
+  }
+
+  /**
+   * @return the order in which the tour visits the nodes, starting at node 0. There has to be a tour.
+   */
+  std::vector<NodeId> order() const {
+      std::vector<NodeId> result;
+      result.reserve(_n);
+      NodeId previous = _n, v = 0;
+      for (size_type i = 0; i < _n; i++) {
+          result.push_back(v);
+          NodeId next = _adjacent[2 * v] != previous ? _adjacent[2 * v] : _adjacent[2 * v + 1];
+          previous = v;
+          v = next;
+      }
+      return result;
+  }
+
+ private:
+  size_type _n;
+  // the neighbors of v in slots 2v and 2v+1, n for none
+  std::vector<NodeId> _adjacent;
+  // for the ends of a path the other end, the node itself for a path without edges
+  std::vector<NodeId> _other_end;
+  size_type _num_edges;
+};
+
+/**
+ * Greedy edge heuristic: the edges between neighbors are added by increasing weight, unless an end
+ * node has degree 2 already or they close a cycle. The resulting paths are joined by going from the
+ * end of one to the nearest free end of another one.
+ * @param tsp The TSP Instance
+ * @param neighbors candidate edges, e.g. nearest_neighbor_lists
+ * @return the order in which the tour visits the nodes
+ */
+template<class coord_type, class dist_type>
+std::vector<NodeId> greedy_tour(const Instance<coord_type, dist_type> &tsp,
+                                const std::vector<std::vector<NodeId> > &neighbors) {
+    const size_type n = tsp.size();
+    std::vector<std::pair<dist_type, std::pair<NodeId, NodeId> > > edges;
+    for (NodeId i = 0; i < n; i++)
+        for (NodeId j : neighbors[i])
+            if (i < j || std::find(neighbors[j].begin(), neighbors[j].end(), i) == neighbors[j].end())
+                edges.push_back(std::make_pair(tsp.weight(i, j), std::make_pair(std::min(i, j), std::max(i, j))));
+    std::sort(edges.begin(), edges.end());
+
+    PathFragments fragments(n);
+    for (const auto &el : edges)
+        if (fragments.can_link(el.second.first, el.second.second))
+            fragments.link(el.second.first, el.second.second);
+    fragments.join(tsp.spatial_index(), [](NodeId, NodeId) { return true; });
+    return fragments.order();
+}
+
+/**
+ * Patches a 1-tree into a tour of the same constraints: the required edges first, then the edges of
+ * the 1-tree by increasing weight as far as they keep the degrees at most 2 and close no cycle. The
+ * paths left are joined by PathFragments::join() without forbidden edges.
+ * @param tsp The TSP Instance
+ * @param tree a 1-tree which satisfies the constraints
+ * @param constraints required and forbidden edges
+ * @param order placeholder for the order in which the tour visits the nodes
+ * @param patched the ends of the edges which are not in the 1-tree are appended here
+ * @return false, if no tour was found this way
+ */
+template<class coord_type, class dist_type>
+bool repair_tour(const Instance<coord_type, dist_type> &tsp,
+                 const OneTree &tree,
+                 const Constraints &constraints,
+                 std::vector<NodeId> &order,
+                 std::vector<NodeId> &patched) {
+    const size_type n = tsp.size();
+    PathFragments fragments(n);
+    for (NodeId i = 0; i < n; i++)
+        for (NodeId j : constraints.required_neighbors()[i].neighbors()) {
+            if (i > j)
+                continue;
+            if (!fragments.can_link(i, j))
+                return false;
+            fragments.link(i, j);
+        }
+    std::vector<std::pair<dist_type, std::pair<NodeId, NodeId> > > edges;
+    tree.for_each_edge([&](NodeId i, NodeId j) {
+        edges.push_back(std::make_pair(tsp.weight(i, j), std::make_pair(i, j)));
+    });
+    std::sort(edges.begin(), edges.end());
+    for (const auto &el : edges)
+        if (fragments.can_link(el.second.first, el.second.second))
+            fragments.link(el.second.first, el.second.second);
+    auto allowed = [&](NodeId i, NodeId j) {
+        return !constraints.is_forbidden(to_EdgeId(i, j, n));
+    };
+    if (!fragments.join(tsp.spatial_index(), allowed, &patched))
+        return false;
+    order = fragments.order();
+    return true;
+}
+
+/**
+ * @class LocalSearch
+ * 2-opt, Or-opt and, optionally, Lin-Kernighan steps on a tour stored as an array of nodes and their
+ * positions. All of them only look at neighbors in the given lists, and nodes whose surroundings did not
+ * change are not looked at again (don't-look bits). A reversal turns the shorter side of the tour around.
+ * With constraints, 2-opt and Or-opt keep the required edges and add no forbidden ones, Lin-Kernighan
+ * steps and kicks are left out.
+ * @tparam coord_type
+ * @tparam dist_type
+ */
+template<class coord_type, class dist_type>
+class LocalSearch {
+ public:
+  /**
+   * @param tsp The TSP Instance
+   * @param neighbors candidate lists, the more promising neighbors first
+   * @param depth maximal number of 2-opt moves of a Lin-Kernighan step, 0 for none
+   */
+  LocalSearch(const Instance<coord_type, dist_type> &tsp, const std::vector<std::vector<NodeId> > &neighbors,
+              size_type depth = 0)
+      : _tsp(tsp), _neighbors(neighbors), _n(tsp.size()), _depth(depth), _constraints(nullptr), _choices(depth) {}
+
+  /**
+   * @param constraints the edges the moves have to respect from now on, nullptr for none
+   */
+  void set_constraints(const Constraints *constraints) {
+      _constraints = constraints;
+  }
+
+  /**
+   * improves the tour until no move finds an improvement. Then, for each kick, two neighboring segments
+   * of the tour are swapped (a double bridge, which no sequential move undoes) and the tour is improved
+   * again from there. It is kept, if it got shorter.
+   * @param order the order in which the tour visits the nodes, replaced by the improved one
+   * @param kicks number of double bridges
+   * @return the length of the improved tour
+   */
+  dist_type improve(std::vector<NodeId> &order, size_type kicks = 0) {
+      _order = order;
+      set_positions();
+      if (_n < 5)
+          return tour_length(_tsp, order);
+      _active.assign(_n, true);
+      _queue = _order;
+      optimize();
+      dist_type length = tour_length(_tsp, _order);
+      if (_n >= 8 && !_constraints) {
+          std::vector<NodeId> best(_order);
+          std::mt19937 random(0);
+          const size_type window = std::min<size_type>(50, _n - 2);
+          for (size_type kick = 0; kick < kicks; kick++) {
+              size_type start = random() % _n, a = 1 + random() % window, b = 1 + random() % window;
+              if (a == b)
+                  continue;
+              double_bridge(start, std::min(a, b), std::max(a, b));
+              optimize();
+              dist_type kicked = tour_length(_tsp, _order);
+              if (kicked < length) {
+                  length = kicked;
+                  best = _order;
+              } else {
+                  _order = best;
+                  set_positions();
+              }
+          }
+      }
+      order = _order;
+      return length;
+  }
+
+  /**
+   * improves a tour of which only the surroundings of some nodes changed, starting from these
+   * @param order the order in which the tour visits the nodes, replaced by the improved one
+   * @param changed the nodes to start from
+   * @return the length of the improved tour
+   */
+  dist_type polish(std::vector<NodeId> &order, const std::vector<NodeId> &changed) {
+      _order = order;
+      set_positions();
+      if (_n >= 5) {
+          _active.assign(_n, false);
+          _queue.clear();
+          for (NodeId v : changed)
+              activate(v);
+          optimize();
+      }
+      order = _order;
+      return tour_length(_tsp, order);
+  }
+
+ private:
+  void set_positions() {
+      _pos.assign(_n, 0);
+      for (size_type i = 0; i < _n; i++)
+          _pos[_order[i]] = i;
+  }
+
+  /**
+   * applies the moves until no active node is left
+   */
+  void optimize() {
+      while (!_queue.empty()) {
+          NodeId v = _queue.back();
+          _queue.pop_back();
+          _active[v] = false;
+          if (two_opt(v) || or_opt(v) || (_depth > 0 && !_constraints && lin_kernighan(v)))
+              activate(v);
+      }
+  }
+
+  /**
+   * swaps the segments at positions start+1..start+a and start+a+1..start+b (modulo n) and activates
+   * the nodes at their ends
+   */
+  void double_bridge(size_type start, size_type a, size_type b) {
+      auto at = [&](size_type offset) -> NodeId & {
+          return _order[(start + offset) % _n];
+      };
+      std::vector<NodeId> segments;
+      for (size_type offset = a + 1; offset <= b; offset++)
+          segments.push_back(at(offset));
+      for (size_type offset = 1; offset <= a; offset++)
+          segments.push_back(at(offset));
+      for (size_type offset = 1; offset <= b; offset++) {
+          at(offset) = segments[offset - 1];
+          _pos[at(offset)] = (start + offset) % _n;
+      }
+      for (size_type offset : {size_type(0), size_type(1), b - a, b - a + 1, b, b + 1})
+          activate(at(offset));
+  }
+
+  NodeId succ(NodeId v) const {
+      return _order[_pos[v] + 1 == _n ? 0 : _pos[v] + 1];
+  }
+  NodeId pred(NodeId v) const {
+      return _order[_pos[v] == 0 ? _n - 1 : _pos[v] - 1];
+  }
+  dist_type d(NodeId v, NodeId w) const {
+      return _tsp.weight(v, w);
+  }
+
+  bool is_required(NodeId v, NodeId w) const {
+      return _constraints && _constraints->is_required(to_EdgeId(v, w, _n));
+  }
+  bool is_forbidden(NodeId v, NodeId w) const {
+      return _constraints && _constraints->is_forbidden(to_EdgeId(v, w, _n));
+  }
+
+  void activate(NodeId v) {
+      if (!_active[v]) {
+          _active[v] = true;
+          _queue.push_back(v);
+      }
+  }
+
+  /**
+   * reverses the path from v to w in tour direction, or the rest of the tour if that is shorter
+   */
+  void reverse(NodeId v, NodeId w) {
+      size_type i = _pos[v], j = _pos[w];
+      size_type length = (j + _n - i) % _n + 1;
+      if (2 * length > _n) { // the other side, from succ(w) to pred(v)
+          i = _pos[succ(w)];
+          j = _pos[pred(v)];
+          length = _n - length;
+      }
+      for (size_type k = 0; k < length / 2; k++) {
+          std::swap(_order[i], _order[j]);
+          _pos[_order[i]] = i;
+          _pos[_order[j]] = j;
+          i = (i + 1 == _n) ? 0 : i + 1;
+          j = (j == 0) ? _n - 1 : j - 1;
+      }
+  }
+
+  /**
+   * replaces the tour edges {t1,t2} and {t3,t4} by {t1,t3} and {t2,t4}, where t2 follows t1 and t4
+   * follows t3 in the same direction
+   */
+  void exchange(NodeId t1, NodeId t2, NodeId t3, NodeId t4) {
+      if (succ(t1) == t2 && succ(t3) == t4) {
+          reverse(t2, t3);
+      } else {
+          assert(pred(t1) == t2 && pred(t3) == t4);
+          reverse(t3, t2);
+      }
+  }
+
+  /**
+   * exchange() and activates the end nodes
+   */
+  void move(NodeId t1, NodeId t2, NodeId t3, NodeId t4) {
+      exchange(t1, t2, t3, t4);
+      activate(t1);
+      activate(t2);
+      activate(t3);
+      activate(t4);
+  }
+
+  bool two_opt(NodeId t1) {
+      for (int direction = 0; direction < 2; direction++) {
+          NodeId t2 = direction ? pred(t1) : succ(t1);
+          dist_type removed = d(t1, t2);
+          for (NodeId t3 : _neighbors[t1]) {
+              dist_type gain = removed - d(t1, t3);
+              if (gain <= 0)
+                  continue;
+              NodeId t4 = direction ? pred(t3) : succ(t3);
+              if (t3 == t2 || t4 == t1)
+                  continue;
+              if (gain + d(t3, t4) - d(t2, t4) > 0 && !is_required(t1, t2) && !is_required(t3, t4)
+                  && !is_forbidden(t1, t3) && !is_forbidden(t2, t4)) {
+                  move(t1, t2, t3, t4);
+                  return true;
+              }
+          }
+      }
+      return false;
+  }
+
+  /**
+   * moves a segment of up to three nodes starting or ending at v between two neighbors of its ends,
+   * possibly reversed
+   */
+  bool or_opt(NodeId v) {
+      for (size_type length = 1; length <= 3 && length + 3 <= _n; length++) {
+          for (int direction = 0; direction < 2; direction++) {
+              // the segment s1..s2 in tour direction, between a and b
+              NodeId s1 = v, s2 = v;
+              for (size_type k = 1; k < length; k++) {
+                  if (direction)
+                      s1 = pred(s1);
+                  else
+                      s2 = succ(s2);
+              }
+              NodeId a = pred(s1), b = succ(s2);
+              dist_type removed = d(a, s1) + d(s2, b) - d(a, b);
+              if (removed <= 0)
+                  continue;
+              auto in_segment = [&](NodeId w) {
+                  return (_pos[w] + _n - _pos[s1]) % _n < length;
+              };
+              for (NodeId end : {s1, s2}) {
+                  for (NodeId c : _neighbors[end]) {
+                      if (d(end, c) >= removed || in_segment(c))
+                          continue;
+                      for (NodeId e : {succ(c), pred(c)}) {
+                          if (in_segment(e))
+                              continue;
+                          dist_type added = std::min(d(c, s1) + d(s2, e), d(c, s2) + d(s1, e)) - d(c, e);
+                          if (removed - added > 0 && insert(s1, s2, c, e))
+                              return true;
+                      }
+                  }
+              }
+          }
+      }
+      return false;
+  }
+
+  /**
+   * moves the segment s1..s2 (in tour direction) between the adjacent nodes c and e in the cheaper
+   * orientation, by two or three 2-opt moves
+   * @return false, if the move is degenerate, i.e. e precedes the segment directly, or violates the
+   * constraints
+   */
+  bool insert(NodeId s1, NodeId s2, NodeId c, NodeId e) {
+      NodeId a = pred(s1), b = succ(s2);
+      // c's end is attached to s2 after the first two moves, the other one to s1
+      bool flip = d(c, s1) + d(s2, e) < d(c, s2) + d(s1, e);
+      if (_constraints && (is_required(a, s1) || is_required(s2, b) || is_required(c, e) || is_forbidden(a, b)
+          || (flip ? is_forbidden(c, s1) || is_forbidden(s2, e) : is_forbidden(c, s2) || is_forbidden(s1, e))))
+          return false;
+      if (succ(c) != e) {
+          std::swap(c, e);
+          flip = !flip;
+      }
+      if (e == a)
+          return false;
+      move(a, s1, c, e);
+      if (c != b)
+          move(a, c, b, s2);
+      if (flip)
+          move(c, s2, s1, e);
+      return true;
+  }
+
+  /**
+   * Lin-Kernighan step from t1 in both directions: removing a tour edge {t1,t2} leaves a path, which is
+   * extended by an edge {t2,t3} to a candidate t3 and closed again by removing the edge {t3,t4} behind
+   * it and adding {t4,t1}, i.e. by a 2-opt move. As long as the gain without the closing edge stays
+   * positive, the step goes on from {t1,t4}, trying 5, 3 and then one candidate per level. An edge added
+   * by the step is not removed again and vice versa. The tour of the largest gain along the way is kept.
+   * @return true, if the tour was improved. Otherwise it is unchanged.
+   */
+  bool lin_kernighan(NodeId t1) {
+      for (NodeId t2 : {succ(t1), pred(t1)}) {
+          _removed.assign(1, edge(t1, t2));
+          _added.clear();
+          if (deepen(t1, t2, d(t1, t2), 0, 0) > 0)
+              return true;
+      }
+      return false;
+  }
+
+  static std::pair<NodeId, NodeId> edge(NodeId v, NodeId w) {
+      return std::make_pair(std::min(v, w), std::max(v, w));
+  }
+
+  static bool contains(const std::vector<std::pair<NodeId, NodeId> > &edges, std::pair<NodeId, NodeId> e) {
+      return std::find(edges.begin(), edges.end(), e) != edges.end();
+  }
+
+  /**
+   * @param t1 start of the step
+   * @param t2 end of the path, {t1,t2} is the closing edge of the tour
+   * @param gain weight removed minus weight added so far, without {t1,t2}
+   * @param level number of moves so far
+   * @param threshold gain of the tour as it is
+   * @return the gain of the tour kept, if it is larger than threshold. Otherwise 0 and all moves of this
+   * level and below are taken back.
+   */
+  dist_type deepen(NodeId t1, NodeId t2, dist_type gain, size_type level, dist_type threshold) {
+      // the valid (t3, t4), the largest d(t3,t4) - d(t2,t3) first
+      std::vector<std::pair<dist_type, std::pair<NodeId, NodeId> > > &choices = _choices[level];
+      choices.clear();
+      for (NodeId t3 : _neighbors[t2]) {
+          if (gain - d(t2, t3) <= 0 || t3 == succ(t2) || t3 == pred(t2))
+              continue;
+          NodeId t4 = succ(t2) == t1 ? succ(t3) : pred(t3);
+          if (t4 == t1 || contains(_removed, edge(t2, t3)) || contains(_added, edge(t3, t4)))
+              continue;
+          choices.push_back(std::make_pair(d(t2, t3) - d(t3, t4), std::make_pair(t3, t4)));
+      }
+      const size_type breadth = std::min<size_type>(level == 0 ? 5 : (level == 1 ? 3 : 1), choices.size());
+      std::partial_sort(choices.begin(), choices.begin() + breadth, choices.end());
+      for (size_type choice = 0; choice < breadth; choice++) {
+          NodeId t3 = choices[choice].second.first, t4 = choices[choice].second.second;
+          dist_type partial = gain - choices[choice].first;
+          exchange(t2, t1, t3, t4);
+          _added.push_back(edge(t2, t3));
+          _removed.push_back(edge(t3, t4));
+          dist_type closed = partial - d(t4, t1), best = 0;
+          if (level + 1 < _depth)
+              best = deepen(t1, t4, partial, level + 1, std::max(threshold, closed));
+          if (best == 0 && closed > threshold)
+              best = closed;
+          _added.pop_back();
+          _removed.pop_back();
+          if (best > 0) {
+              activate(t1);
+              activate(t2);
+              activate(t3);
+              activate(t4);
+              return best;
+          }
+          exchange(t3, t2, t4, t1);
+      }
+      return 0;
+  }
+
+  const Instance<coord_type, dist_type> &_tsp;
+  const std::vector<std::vector<NodeId> > &_neighbors;
+  size_type _n;
+  size_type _depth;
+  const Constraints *_constraints;
+  // edges added and removed by the current Lin-Kernighan step
+  std::vector<std::pair<NodeId, NodeId> > _added, _removed;
+  // scratch space of every level of a Lin-Kernighan step
+  std::vector<std::vector<std::pair<dist_type, std::pair<NodeId, NodeId> > > > _choices;
+  std::vector<NodeId> _order;
+  std::vector<size_type> _pos;
+  std::vector<char> _active;
+  std::vector<NodeId> _queue;
+};
+
+}
+
+#endif //BRANCHANDBOUNDTSP_HEURISTIC_HPP
@@ -0,0 +1,160 @@
+/**
+ * @file kdtree.hpp
+ *
+ * @brief A 2-dimensional k-d tree over the coordinates of an instance, answering nearest neighbor and
+ * radius queries in about O(log n) instead of scanning all nodes
+ */
+#ifndef BRANCHANDBOUNDTSP_KDTREE_HPP
+#define BRANCHANDBOUNDTSP_KDTREE_HPP
+
+#include <cstdlib>
+#include <algorithm>
+#include <numeric>
+#include <queue>
+#include <utility>
+#include <vector>
+
+namespace TSP {
+using size_type = std::size_t;
+using NodeId = size_type;
+
+/**
+ * @class KdTree
+ * The tree is stored implicitly: the nodes are permuted such that the median of every range splits it
+ * along the axis with the larger spread. Distances are Euclidean, ties are broken by the smaller NodeId.
+ * @tparam coord_type Container in which the Coordinates are given. Assumably double
+ */
+template<class coord_type>
+class KdTree {
+ public:
+  /**
+   * empty tree
+   */
+  KdTree() {}
+
+  /**
+   * Builds the tree in O(n log n)
+   * @param x x-coordinates of the nodes
+   * @param y y-coordinates of the nodes
+   */
+  KdTree(const std::vector<coord_type> &x, const std::vector<coord_type> &y)
+      : _x(x.begin(), x.end()), _y(y.begin(), y.end()), _perm(x.size()), _axis(x.size(), 0) {
+      std::iota(_perm.begin(), _perm.end(), 0);
+      build(0, _perm.size());
+  }
+
+  size_type size() const {
+      return _perm.size();
+  }
+
+  /**
+   * @param i
+   * @param k
+   * @return the (at most) k nodes closest to node i, excluding i, ordered by distance
+   */
+  std::vector<NodeId> nearest(NodeId i, size_type k) const {
+      return nearest_if(i, k, [](NodeId) { return true; });
+  }
+
+  /**
+   * @param i
+   * @param k
+   * @param pred only nodes j with pred(j) == true are considered
+   * @return the (at most) k nodes closest to node i satisfying pred, excluding i, ordered by distance
+   */
+  template<class Predicate>
+  std::vector<NodeId> nearest_if(NodeId i, size_type k, Predicate pred) const {
+      Heap heap;
+      if (k > 0)
+          search_nearest(0, _perm.size(), i, k, pred, heap);
+      std::vector<NodeId> result(heap.size());
+      for (size_type pos = result.size(); pos-- > 0; heap.pop())
+          result[pos] = heap.top().second;
+      return result;
+  }
+
+  /**
+   * @param i
+   * @param radius
+   * @return all nodes j != i with distance at most radius to node i, in no particular order
+   */
+  std::vector<NodeId> within(NodeId i, double radius) const {
+      std::vector<NodeId> result;
+      search_within(0, _perm.size(), i, radius * radius, result);
+      return result;
+  }
+
+ private:
+  // max-heap of (squared distance, node), the worst of the k best on top
+  typedef std::priority_queue<std::pair<double, NodeId> > Heap;
+
+  double coord(NodeId i, char axis) const {
+      return axis ? _y[i] : _x[i];
+  }
+
+  double squared_distance(NodeId i, NodeId j) const {
+      double dx = _x[i] - _x[j], dy = _y[i] - _y[j];
+      return dx * dx + dy * dy;
+  }
+
+  void build(size_type begin, size_type end) {
+      if (end - begin < 2)
+          return;
+      auto x_range = std::minmax_element(_perm.begin() + begin, _perm.begin() + end,
+                                         [&](NodeId a, NodeId b) { return _x[a] < _x[b]; });
+      auto y_range = std::minmax_element(_perm.begin() + begin, _perm.begin() + end,
+                                         [&](NodeId a, NodeId b) { return _y[a] < _y[b]; });
+      char axis = (_x[*x_range.second] - _x[*x_range.first] < _y[*y_range.second] - _y[*y_range.first]);
+      size_type mid = begin + (end - begin) / 2;
+      std::nth_element(_perm.begin() + begin, _perm.begin() + mid, _perm.begin() + end,
+                       [&](NodeId a, NodeId b) { return coord(a, axis) < coord(b, axis); });
+      _axis[mid] = axis;
+      build(begin, mid);
+      build(mid + 1, end);
+  }
+
+  template<class Predicate>
+  void search_nearest(size_type begin, size_type end, NodeId i, size_type k, Predicate &pred, Heap &heap) const {
+      if (begin >= end)
+          return;
+      size_type mid = begin + (end - begin) / 2;
+      NodeId p = _perm[mid];
+      if (p != i && pred(p)) {
+          std::pair<double, NodeId> candidate(squared_distance(i, p), p);
+          if (heap.size() < k) {
+              heap.push(candidate);
+          } else if (candidate < heap.top()) {
+              heap.pop();
+              heap.push(candidate);
+          }
+      }
+      double diff = coord(i, _axis[mid]) - coord(p, _axis[mid]);
+      bool left_first = diff < 0;
+      search_nearest(left_first ? begin : mid + 1, left_first ? mid : end, i, k, pred, heap);
+      if (heap.size() < k || diff * diff <= heap.top().first)
+          search_nearest(left_first ? mid + 1 : begin, left_first ? end : mid, i, k, pred, heap);
+  }
+
+  void search_within(size_type begin, size_type end, NodeId i, double squared_radius,
+                     std::vector<NodeId> &result) const {
+      if (begin >= end)
+          return;
+      size_type mid = begin + (end - begin) / 2;
+      NodeId p = _perm[mid];
+      if (p != i && squared_distance(i, p) <= squared_radius)
+          result.push_back(p);
+      double diff = coord(i, _axis[mid]) - coord(p, _axis[mid]);
+      if (diff <= 0 || diff * diff <= squared_radius)
+          search_within(begin, mid, i, squared_radius, result);
+      if (diff >= 0 || diff * diff <= squared_radius)
+          search_within(mid + 1, end, i, squared_radius, result);
+  }
+
+  std::vector<double> _x, _y;
+  std::vector<NodeId> _perm;
+  std::vector<char> _axis;
+};
+
+}
+
+#endif //BRANCHANDBOUNDTSP_KDTREE_HPP
@@ -0,0 +1,279 @@
+/**
+ * @file node_pool.hpp
+ *
+ * @brief The open list of the best-first search: the nodes live in a pool and are moved in and out,
+ * the queue only orders their indices by bound
+ */
+#ifndef BRANCHANDBOUNDTSP_NODE_POOL_HPP
+#define BRANCHANDBOUNDTSP_NODE_POOL_HPP
+
+#include <cassert>
+#include <cstdlib>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <utility>
+#include <vector>
+
+namespace TSP {
+using size_type = std::size_t;
+
+/**
+ * @class NodePool
+ * A slab of elements addressed by their index. Freed slots are reused by the next insert, so once the
+ * pool has grown to the maximal number of elements alive at a time, inserting does not allocate.
+ * Elements are only ever moved, never copied.
+ * @tparam T element type, needs to be move assignable
+ */
+template<class T>
+class NodePool {
+ public:
+  /**
+   * @param el element, moved into the pool
+   * @return the index of its slot
+   */
+  size_type insert(T &&el) {
+      if (_free.empty()) {
+          _slots.push_back(std::move(el));
+          return _slots.size() - 1;
+      }
+      size_type idx = _free.back();
+      _free.pop_back();
+      _slots[idx] = std::move(el);
+      return idx;
+  }
+
+  /**
+   * moves the element out of slot @p idx and frees the slot
+   */
+  T take(size_type idx) {
+      T el(std::move(_slots[idx]));
+      _free.push_back(idx);
+      return el;
+  }
+
+  const T &operator[](size_type idx) const {
+      return _slots[idx];
+  }
+
+  /**
+   * @return number of elements in the pool
+   */
+  size_type size() const {
+      return _slots.size() - _free.size();
+  }
+
+ private:
+  std::vector<T> _slots;
+  std::vector<size_type> _free;
+};
+
+/**
+ * @class BucketQueue
+ * Min-queue of elements by an integer key, e.g. of BranchingNodes by their lower bound, which is rounded
+ * up by Held_Karp. The elements are kept in a NodePool, every key in the window
+ * [base, base + max_buckets) has a bucket of indices into it. Pushing and popping take O(1) (amortized
+ * over the empty buckets skipped), and all elements with a key >= some bound are dropped at once by
+ * prune(). Within a bucket the element pushed last is popped first, i.e. the search goes deep among
+ * nodes of equal bound, where it finds tours earlier. Keys above the window wait in an unsorted
+ * overflow list until the window is empty.
+ * @tparam T element type
+ * @tparam key_type type of the keys, only their integral part is used
+ */
+template<class T, class key_type>
+class BucketQueue {
+ public:
+  /// size of the window of keys which have a bucket
+  static const size_type max_buckets = size_type(1) << 20;
+
+  /**
+   * @param el element, moved into the queue
+   * @param key
+   */
+  void push(T &&el, key_type key) {
+      std::int64_t k = to_int(key);
+      if (size() == 0) {
+          _base = k;
+          _first = 0;
+      }
+      place(k, _pool.insert(std::move(el)));
+  }
+
+  /**
+   * moves an element of the smallest key out of the queue
+   */
+  T pop() {
+      assert(!empty());
+      std::vector<size_type> &bucket = _buckets[_first];
+      size_type idx = bucket.back();
+      bucket.pop_back();
+      _in_buckets--;
+      settle();
+      return _pool.take(idx);
+  }
+
+  /**
+   * moves an element of the largest key (or one of the overflow list) out of the queue
+   * @param key placeholder for its key
+   */
+  T pop_worst(key_type &key) {
+      assert(!empty());
+      std::int64_t k = 0;
+      size_type idx = 0;
+      if (!_overflow.empty()) {
+          k = _overflow.back().first;
+          idx = _overflow.back().second;
+          _overflow.pop_back();
+      } else {
+          while (_buckets.back().empty())
+              _buckets.pop_back();
+          k = _base + static_cast<std::int64_t>(_buckets.size() - 1);
+          idx = _buckets.back().back();
+          _buckets.back().pop_back();
+          _in_buckets--;
+          settle();
+      }
+      key = static_cast<key_type>(k);
+      return _pool.take(idx);
+  }
+
+  /**
+   * @return the smallest key
+   */
+  key_type top_key() const {
+      assert(!empty());
+      return static_cast<key_type>(_base + static_cast<std::int64_t>(_first));
+  }
+
+  /**
+   * drops all elements with a key >= upper_bound and releases the memory of their buckets
+   * @return number of dropped elements
+   */
+  size_type prune(key_type upper_bound) {
+      return prune(upper_bound, [](const T &) {});
+  }
+
+  /**
+   * as above, but calls on_drop(el) for every dropped element el before it is destroyed
+   */
+  template<class Function>
+  size_type prune(key_type upper_bound, Function on_drop) {
+      std::int64_t k = to_int(upper_bound);
+      size_type dropped = 0;
+      auto drop = [&](size_type idx) {
+          on_drop(_pool.take(idx));
+          dropped++;
+      };
+      for (size_type bucket = static_cast<size_type>(std::max<std::int64_t>(k - _base, 0));
+           bucket < _buckets.size(); bucket++) {
+          for (size_type idx : _buckets[bucket])
+              drop(idx);
+          _in_buckets -= _buckets[bucket].size();
+      }
+      if (k - _base < static_cast<std::int64_t>(_buckets.size())) {
+          _buckets.resize(static_cast<size_type>(std::max<std::int64_t>(k - _base, 0)));
+          _buckets.shrink_to_fit();
+      }
+      auto end = std::partition(_overflow.begin(), _overflow.end(),
+                                [&](const std::pair<std::int64_t, size_type> &el) { return el.first < k; });
+      for (auto it = end; it != _overflow.end(); ++it)
+          drop(it->second);
+      _overflow.erase(end, _overflow.end());
+      settle();
+      return dropped;
+  }
+
+  /**
+   * calls f(el) for every element el, in no particular order
+   */
+  template<class Function>
+  void for_each(Function f) const {
+      for (const auto &bucket : _buckets)
+          for (size_type idx : bucket)
+              f(_pool[idx]);
+      for (const auto &el : _overflow)
+          f(_pool[el.second]);
+  }
+
+  bool empty() const {
+      return _in_buckets == 0;
+  }
+  size_type size() const {
+      return _in_buckets + _overflow.size();
+  }
+
+ private:
+  // clamped, s.t. differences of two keys do not overflow
+  static std::int64_t to_int(key_type key) {
+      const std::int64_t limit = std::numeric_limits<std::int64_t>::max() / 4;
+      if (!(key < key_type(limit)))
+          return limit;
+      if (!(key > key_type(-limit)))
+          return -limit;
+      return static_cast<std::int64_t>(std::floor(key));
+  }
+
+  /**
+   * puts the index of an element with key k into its bucket or into the overflow list
+   */
+  void place(std::int64_t k, size_type idx) {
+      if (k < _base && static_cast<std::uint64_t>(_base - k) >= max_buckets) { // start a new window at k
+          for (size_type bucket = 0; bucket < _buckets.size(); bucket++)
+              for (size_type el : _buckets[bucket])
+                  _overflow.push_back(std::make_pair(_base + static_cast<std::int64_t>(bucket), el));
+          _buckets.clear();
+          _in_buckets = 0;
+          _base = k;
+      } else if (k < _base) { // rare, a child may get a slightly smaller bound than its parent
+          _buckets.insert(_buckets.begin(), static_cast<size_type>(_base - k), std::vector<size_type>());
+          _first += static_cast<size_type>(_base - k);
+          _base = k;
+      }
+      if (static_cast<std::uint64_t>(k - _base) >= max_buckets) {
+          _overflow.push_back(std::make_pair(k, idx));
+          return;
+      }
+      size_type bucket = static_cast<size_type>(k - _base);
+      if (bucket >= _buckets.size())
+          _buckets.resize(bucket + 1);
+      if (_in_buckets == 0 || bucket < _first)
+          _first = bucket;
+      _buckets[bucket].push_back(idx);
+      _in_buckets++;
+  }
+
+  /**
+   * moves _first to the first non-empty bucket. If the window is empty, it is moved to the smallest key
+   * of the overflow list.
+   */
+  void settle() {
+      if (_in_buckets == 0) {
+          _buckets.clear();
+          _first = 0;
+          if (_overflow.empty())
+              return;
+          std::vector<std::pair<std::int64_t, size_type> > overflow;
+          overflow.swap(_overflow);
+          _base = std::min_element(overflow.begin(), overflow.end())->first;
+          for (const auto &el : overflow)
+              place(el.first, el.second);
+          return;
+      }
+      while (_buckets[_first].empty())
+          _first++;
+  }
+
+  NodePool<T> _pool;
+  std::vector<std::vector<size_type> > _buckets;
+  std::vector<std::pair<std::int64_t, size_type> > _overflow;
+  // key of bucket 0
+  std::int64_t _base = 0;
+  // first non-empty bucket, if there is any
+  size_type _first = 0;
+  size_type _in_buckets = 0;
+};
+
+}
+
+#endif //BRANCHANDBOUNDTSP_NODE_POOL_HPP
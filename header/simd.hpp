@@ -0,0 +1,39 @@
+/**
+ * @file simd.hpp
+ *
+ * @brief Vectorized inner loop of the dense Prim algorithm. There are kernels for SSE2, AVX2 and AVX-512;
+ * which one is used is decided once at runtime by asking the CPU, so the binary does not have to be
+ * compiled for the machine it runs on.
+ */
+#ifndef BRANCHANDBOUNDTSP_SIMD_HPP
+#define BRANCHANDBOUNDTSP_SIMD_HPP
+
+#include <cstddef>
+#include <cstdint>
+
+namespace TSP {
+namespace simd {
+
+/**
+ * Signature of the relax and argmin kernels. For all i < n they compute
+ * \f$ w_i = row_i + offset_i \f$ and, if \f$ w_i < key_i \f$, set \f$ key_i = w_i \f$ and \f$ parent_i = u \f$.
+ * @return the smallest i with minimal key, n if all keys are +inf
+ */
+typedef std::size_t (*RelaxArgminKernel)(const double *row, const double *offset, double *key,
+                                         std::int64_t *parent, std::int64_t u, std::size_t n);
+
+/**
+ * @return the kernel for the best instruction set this CPU supports. It is selected on the first call;
+ * the environment variable TSP_SIMD (scalar, sse2, avx2, avx512) restricts the choice.
+ */
+RelaxArgminKernel relax_argmin_kernel();
+
+/**
+ * @return name of the instruction set of relax_argmin_kernel()
+ */
+const char *kernel_name();
+
+} // namespace simd
+} // namespace TSP
+
+#endif //BRANCHANDBOUNDTSP_SIMD_HPP
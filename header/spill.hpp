@@ -0,0 +1,274 @@
+/**
+ * @file spill.hpp
+ *
+ * @brief An open list with a memory cap: above it, the worst open nodes are written to a spill file and
+ * read back once the nodes in memory run low
+ */
+#ifndef BRANCHANDBOUNDTSP_SPILL_HPP
+#define BRANCHANDBOUNDTSP_SPILL_HPP
+
+#include <cstdio>
+#include <cstdlib>
+#include <algorithm>
+#include <functional>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+#include <unistd.h>
+#include "node_pool.hpp"
+
+namespace TSP {
+using size_type = std::size_t;
+
+/**
+ * @class SpilledRecords
+ * Elements of a spill file at some point in time, which can be read from another thread, e.g. to write
+ * them into a checkpoint. It holds its own descriptor of the file, so it stays readable if the queue
+ * moves on to a new file.
+ */
+class SpilledRecords {
+ public:
+  SpilledRecords() = default;
+  SpilledRecords(const SpilledRecords &) = delete;
+  SpilledRecords &operator=(const SpilledRecords &) = delete;
+  SpilledRecords(SpilledRecords &&rhs) noexcept : _fd(rhs._fd), _records(std::move(rhs._records)) {
+      rhs._fd = -1;
+  }
+  ~SpilledRecords() {
+      if (_fd >= 0)
+          ::close(_fd);
+  }
+
+  /**
+   * @param file spill file, all writes to it have to be flushed
+   * @param records (offset, length) of the elements
+   */
+  SpilledRecords(std::FILE *file, std::vector<std::pair<long, size_type> > &&records)
+      : _fd(::dup(fileno(file))), _records(std::move(records)) {
+      if (_fd < 0)
+          throw std::runtime_error("Could not duplicate the spill file");
+  }
+
+  size_type size() const {
+      return _records.size();
+  }
+
+  /**
+   * @param i
+   * @param data placeholder for the bytes of element i
+   */
+  void read(size_type i, std::string &data) const {
+      data.resize(_records[i].second);
+      if (::pread(_fd, &data[0], data.size(), _records[i].first) != static_cast<ssize_t>(data.size()))
+          throw std::runtime_error("Could not read from the spill file");
+  }
+
+ private:
+  int _fd = -1;
+  std::vector<std::pair<long, size_type> > _records;
+};
+
+/**
+ * @class SpillingQueue
+ * A BucketQueue whose elements take at most memory_limit bytes. If a push exceeds the limit, the
+ * elements of the largest keys are written to an anonymous temporary file until 3/4 of the limit are
+ * left. They are read back, the best first, if the queue in memory runs empty or its best key is worse
+ * than the best one on disk, until half of the limit is used. The file is removed by the system when
+ * it is closed, also if the process is killed.
+ * @tparam T element type, needs memory(), save(std::ostream &), a constructor from std::istream & and,
+ * for snapshot(), share()
+ * @tparam key_type
+ */
+template<class T, class key_type>
+class SpillingQueue {
+ public:
+  /**
+   * @param memory_limit bytes the elements in memory may take, 0 for no limit
+   */
+  explicit SpillingQueue(size_type memory_limit = 0) : _limit(memory_limit) {}
+
+  /**
+   * @param el element, moved into the queue
+   * @param key
+   */
+  void push(T &&el, key_type key) {
+      _bytes += el.memory();
+      _queue.push(std::move(el), key);
+      if (_limit > 0 && _bytes > _limit)
+          spill();
+  }
+
+  /**
+   * moves an element of the smallest key out of the queue, reading elements back from disk first if
+   * the best ones are there
+   */
+  T pop() {
+      if (!_spilled.empty() && (_queue.empty() || _spilled.front().key < _queue.top_key()))
+          reload();
+      T el = _queue.pop();
+      _bytes -= el.memory();
+      return el;
+  }
+
+  /**
+   * @return the smallest key, in memory or on disk
+   */
+  key_type top_key() const {
+      if (_spilled.empty())
+          return _queue.top_key();
+      if (_queue.empty())
+          return _spilled.front().key;
+      return std::min(_queue.top_key(), _spilled.front().key);
+  }
+
+  /**
+   * drops all elements with a key >= upper_bound, those on disk are just forgotten
+   * @return number of dropped elements
+   */
+  size_type prune(key_type upper_bound) {
+      return prune(upper_bound, [](const T &) {}, false);
+  }
+
+  /**
+   * as above, but calls on_drop(el) for every dropped element el, those on disk are read back for it
+   */
+  template<class Function>
+  size_type prune(key_type upper_bound, Function on_drop) {
+      return prune(upper_bound, on_drop, true);
+  }
+
+  bool empty() const {
+      return _queue.empty() && _spilled.empty();
+  }
+  size_type size() const {
+      return _queue.size() + _spilled.size();
+  }
+
+  /**
+   * takes a snapshot of all elements without copying their data, for a checkpoint
+   * @param elements the elements in memory are appended here as T::share()
+   * @param spilled the elements on disk are appended here
+   */
+  void snapshot(std::vector<T> &elements, std::vector<SpilledRecords> &spilled) {
+      _queue.for_each([&](const T &el) { elements.push_back(el.share()); });
+      if (_spilled.empty())
+          return;
+      std::fflush(_file.get());
+      std::vector<std::pair<long, size_type> > records;
+      for (const auto &el : _spilled)
+          records.push_back(std::make_pair(el.offset, el.length));
+      spilled.emplace_back(_file.get(), std::move(records));
+  }
+
+  /**
+   * @return number of elements written to disk so far
+   */
+  size_type num_spilled() const {
+      return _num_spilled;
+  }
+
+ private:
+  // position of one element in the spill file, _spilled is a min-heap of them
+  struct Record {
+    key_type key;
+    long offset;
+    size_type length;
+
+    bool operator>(const Record &rhs) const {
+        return key > rhs.key;
+    }
+  };
+
+  struct FileCloser {
+    void operator()(std::FILE *file) const {
+        std::fclose(file);
+    }
+  };
+
+  template<class Function>
+  size_type prune(key_type upper_bound, Function on_drop, bool read_spilled) {
+      size_type dropped = _queue.prune(upper_bound, [&](const T &el) {
+          _bytes -= el.memory();
+          on_drop(el);
+      });
+      auto end = std::partition(_spilled.begin(), _spilled.end(),
+                                [&](const Record &el) { return el.key < upper_bound; });
+      dropped += _spilled.end() - end;
+      if (read_spilled) {
+          std::string data;
+          for (auto it = end; it != _spilled.end(); ++it) {
+              read(*it, data);
+              std::istringstream in(data);
+              on_drop(T(in));
+          }
+      }
+      _spilled.erase(end, _spilled.end());
+      std::make_heap(_spilled.begin(), _spilled.end(), std::greater<Record>());
+      if (_spilled.empty())
+          _file.reset();
+      return dropped;
+  }
+
+  void read(const Record &record, std::string &data) {
+      data.resize(record.length);
+      if (std::fseek(_file.get(), record.offset, SEEK_SET) != 0
+          || std::fread(&data[0], 1, record.length, _file.get()) != record.length)
+          throw std::runtime_error("Could not read from the spill file");
+  }
+
+  void spill() {
+      if (!_file) {
+          _file.reset(std::tmpfile());
+          if (!_file)
+              throw std::runtime_error("Could not create a spill file");
+      }
+      std::fseek(_file.get(), 0, SEEK_END);
+      while (_bytes > _limit / 4 * 3 && _queue.size() > 1) {
+          Record record;
+          T el = _queue.pop_worst(record.key);
+          _bytes -= el.memory();
+          std::ostringstream out;
+          el.save(out);
+          const std::string data = out.str();
+          record.offset = std::ftell(_file.get());
+          record.length = data.size();
+          if (std::fwrite(data.data(), 1, data.size(), _file.get()) != data.size())
+              throw std::runtime_error("Could not write to the spill file");
+          _spilled.push_back(record);
+          std::push_heap(_spilled.begin(), _spilled.end(), std::greater<Record>());
+          _num_spilled++;
+      }
+  }
+
+  void reload() {
+      std::string data;
+      do {
+          std::pop_heap(_spilled.begin(), _spilled.end(), std::greater<Record>());
+          Record record = _spilled.back();
+          _spilled.pop_back();
+          read(record, data);
+          std::istringstream in(data);
+          T el(in);
+          _bytes += el.memory();
+          _queue.push(std::move(el), record.key);
+      } while (!_spilled.empty() && (_limit == 0 || _bytes < _limit / 2));
+      // all of it is back in memory, the file starts anew
+      if (_spilled.empty())
+          _file.reset();
+  }
+
+  BucketQueue<T, key_type> _queue;
+  size_type _limit;
+  // estimated memory of the elements in _queue
+  size_type _bytes = 0;
+  std::unique_ptr<std::FILE, FileCloser> _file;
+  std::vector<Record> _spilled;
+  size_type _num_spilled = 0;
+};
+
+}
+
+#endif //BRANCHANDBOUNDTSP_SPILL_HPP
@@ -0,0 +1,133 @@
+/**
+ * @file step_policy.hpp
+ *
+ * @brief Step sizes of the subgradient method in Held_Karp and the test when to stop it
+ */
+#ifndef BRANCHANDBOUNDTSP_STEP_POLICY_HPP
+#define BRANCHANDBOUNDTSP_STEP_POLICY_HPP
+
+#include <cstdlib>
+#include <cmath>
+#include <algorithm>
+#include <limits>
+
+namespace TSP {
+using size_type = std::size_t;
+
+/**
+ * Step size rules of the subgradient method.
+ * linear is the schedule of Volgenant and Jonker: t starts at t_0 and decreases by a linearly
+ * shrinking amount, s.t. it ends at 0 after the maximal number of iterations, which it always runs.
+ * polyak takes \f$ t = \mu (target - L(\lambda)) / ||d||^2 \f$ for the direction d, where the target is
+ * the best known tour (or, as long as there is none, the best value plus 1%). \f$ \mu \f$ starts at 1 and
+ * is halved whenever the best value did not improve for a few iterations. It stops once converged.
+ * automatic uses linear up to max_linear_dimension nodes and polyak above.
+ */
+enum class StepRule { linear, polyak, automatic };
+
+/**
+ * Largest dimension for which StepRule::automatic uses the linear rule. Its quadratic number of
+ * iterations in the root is cheap up to here and gives slightly better multipliers for the children.
+ */
+const size_type max_linear_dimension = 200;
+
+/**
+ * What a BranchingNode keeps of its subgradient ascent besides its multipliers, s.t. its children can
+ * continue where it stopped
+ */
+struct AscentState {
+  /// initial step size of the children's ascent, 0 if not calibrated yet
+  double step = 0.;
+  /// number of 1-trees computed by the ascent
+  size_type iterations = 0;
+};
+
+/**
+ * @class StepPolicy
+ * Computes the step sizes of one run of the subgradient method and, for the polyak rule, detects when
+ * it stalls: it has converged if the best value did not improve by a relative 1e-6 for patience()
+ * iterations, or if \f$ \mu \f$ got negligible. The maximal number of iterations is only an upper limit then.
+ * The linear rule does not converge early, its first values are typically far below the start.
+ * @tparam dist_type
+ */
+template<class dist_type>
+class StepPolicy {
+ public:
+  /**
+   * @param rule step size rule, linear or polyak
+   * @param t_0 initial step of the linear rule
+   * @param max_iterations number of iterations the linear rule is laid out for
+   * @param target value the polyak rule aims at, max() if there is no tour yet
+   */
+  StepPolicy(StepRule rule, double t_0, size_type max_iterations, dist_type target)
+      : _rule(rule), _t(t_0), _del(3. * t_0 / (2. * max_iterations)),
+        _deldel(t_0 / (double(max_iterations) * max_iterations - max_iterations)), _target(target),
+        _mu(1.), _best(std::numeric_limits<double>::lowest()), _last_significant(_best),
+        _since_improvement(0), _since_significant(0),
+        _patience(std::max<size_type>(10, std::min<size_type>(max_iterations / 4, 100))),
+        _halve_after(std::max<size_type>(3, _patience / 20)) {}
+
+  /**
+   * @param value value of the current 1-tree
+   * @param norm2 squared norm of the direction lambda is moved in
+   * @return the step size for this iteration
+   */
+  double step(dist_type value, double norm2) {
+      record(value);
+      if (_rule == StepRule::linear) {
+          double t = _t;
+          _t -= _del;
+          _del -= _deldel;
+          return t;
+      }
+      if (_since_improvement >= _halve_after) {
+          _mu /= 2.;
+          _since_improvement = 0;
+      }
+      double target = _target < std::numeric_limits<dist_type>::max()
+                      ? double(_target) : _best + std::max(0.01 * std::fabs(_best), 1.);
+      return _mu * std::max(target - double(value), 0.) / norm2;
+  }
+
+  /**
+   * @return true, if further iterations are unlikely to improve the bound
+   */
+  bool converged() const {
+      return _rule == StepRule::polyak && (_since_significant >= _patience || _mu < 1e-5);
+  }
+
+  size_type patience() const {
+      return _patience;
+  }
+
+ private:
+  void record(dist_type value) {
+      if (value > _best) {
+          _best = value;
+          _since_improvement = 0;
+      } else {
+          _since_improvement++;
+      }
+      if (_best > _last_significant + 1e-6 * std::fabs(_last_significant)) {
+          _last_significant = _best;
+          _since_significant = 0;
+      } else {
+          _since_significant++;
+      }
+  }
+
+  StepRule _rule;
+  // linear rule
+  double _t, _del, _deldel;
+  // polyak rule
+  dist_type _target;
+  double _mu;
+  // stall detection
+  double _best, _last_significant;
+  size_type _since_improvement, _since_significant;
+  size_type _patience, _halve_after;
+};
+
+}
+
+#endif //BRANCHANDBOUNDTSP_STEP_POLICY_HPP
@@ -1,4 +1,4 @@
-k//
+//
 // Created by Alex Dyck and Leon Sievers ; last modified 1/18/18.
 //
 
@@ -12,9 +12,9 @@ k//
 #define BRANCHANDBOUNDTSP_TREE_HPP
 
 #include<cstdlib>
+#include <algorithm>
+#include <limits>
 #include <vector>
-#include <stdexcept>
-#include "graph.hpp"
 #include "util.hpp"
 
 namespace TSP {
@@ -26,67 +26,138 @@ using EdgeId = size_type;
  * General Intentions
  * Given, that we are in the namespace TSP one might think about different trees that could be implemented.
  * Here in particular, we only implement the 1-Tree structure needed by Held-Karp Lower Bound Algorithm.
- * In fact, it's akin to a graph class, but with different constructor and a narrow use for further
- * programming. Formally, one would construct 1-trees such that they share inheritage with a tree and/or
- * a graph. Here, only the Node class is used.
+ * A 1-tree is a spanning tree on {1,..,n-1} plus two edges at node 0, so it is stored as such: every node
+ * of the spanning tree but its root 1 knows its parent, node 0 knows its two neighbors. Together with
+ * the degrees that are three flat arrays, which are reset rather than reallocated between two 1-trees.
  */
 /**
  * @class OneTree
- * 1-tree implementation as a container for Nodes and meta information
+ * 1-tree on the nodes {0,..,size-1} stored as a parent array
  */
 class OneTree {
  public:
+  /// parent of the root of the spanning tree and of the nodes not in it (yet)
+  static constexpr NodeId none = std::numeric_limits<NodeId>::max();
+
   /**
-   * Only constructor. Initializes the meta information and edge vector
+   * Only constructor. Creates a 1-tree without edges
    * @param size size of the tree in terms of Nodes
    */
-  OneTree(size_t size) : _size(size), _edges(0) {
-      _nodes.push_back(Node()); // root pushback. Here, root is always 0
-      for (NodeId node = 1; node < size; node++)
-          _nodes.push_back(Node());
-      num_nodes = _nodes.size();
-      num_edges = 0;
+  OneTree(size_t size) : _parent(size, NodeId(none)), _degree(size, 0), _root_neighbors{none, none}, _num_edges(0) {}
+
+  /**
+   * removes all edges, keeps the memory
+   */
+  void clear() {
+      std::fill(_parent.begin(), _parent.end(), NodeId(none));
+      std::fill(_degree.begin(), _degree.end(), 0);
+      _root_neighbors[0] = _root_neighbors[1] = none;
+      _num_edges = 0;
   }
 
   /**
-   * Adding an edge by their NodeIds. Requires the to_Edge functionality from @headerfile util.hpp
-   * @param i first node
-   * @param j second node
+   * adds the edge {v, parent} of the spanning tree on {1,..,n-1}
+   * @param v node which is not in the spanning tree yet
+   * @param parent node of the spanning tree
    */
-  void add_edge(NodeId i, NodeId j) {
-      if (i >= num_nodes || j >= num_nodes)
-          throw std::runtime_error("Index out of range while adding edge to 1-tree");
-
-      _edges.push_back(to_EdgeId(i, j, _size));
-      _nodes.at(i).add_neighbor(j);
-      _nodes.at(j).add_neighbor(i);
-      num_edges++;
+  void set_parent(NodeId v, NodeId parent) {
+      _parent[v] = parent;
+      _degree[v]++;
+      _degree[parent]++;
+      _num_edges++;
   }
-  //getter functions
-  const size_type &get_num_edges() const {
-      return num_edges;
+
+  /**
+   * adds the edges {0, first} and {0, second}
+   */
+  void set_root_neighbors(NodeId first, NodeId second) {
+      _root_neighbors[0] = first;
+      _root_neighbors[1] = second;
+      _degree[0] += 2;
+      _degree[first]++;
+      _degree[second]++;
+      _num_edges += 2;
   }
-  const std::vector<EdgeId> &get_edges() const {
-      return _edges;
+
+  /**
+   * calls f(i, j) for every edge {i, j}, first those of the spanning tree, then those at node 0
+   */
+  template<class Function>
+  void for_each_edge(Function f) const {
+      for (NodeId v = 1; v < _parent.size(); v++)
+          if (_parent[v] != none)
+              f(v, _parent[v]);
+      for (NodeId w : _root_neighbors)
+          if (w != none)
+              f(NodeId(0), w);
   }
 
-  const std::vector<Node> &get_nodes() const {
-      return _nodes;
+  /**
+   * @return the edges as EdgeIds. Allocates, meant for the final tour only
+   */
+  std::vector<EdgeId> edges() const {
+      std::vector<EdgeId> result;
+      result.reserve(_num_edges);
+      for_each_edge([&](NodeId i, NodeId j) { result.push_back(to_EdgeId(i, j, _parent.size())); });
+      return result;
   }
 
-  const Node &get_node(NodeId id) const {
-      return _nodes.at(id);
+  /**
+   * @return true, if every node has degree 2, i.e. the 1-tree is a tour
+   */
+  bool is_tour() const {
+      for (size_type el : _degree)
+          if (el != 2)
+              return false;
+      return true;
   }
 
- private:
-  //names are self-explainatory
-  size_type _size;
+  /**
+   * @return the neighbors of v: parent, children by increasing id, node 0. Takes O(n)
+   */
+  std::vector<NodeId> neighbors(NodeId v) const {
+      std::vector<NodeId> result;
+      if (v == 0) {
+          for (NodeId w : _root_neighbors)
+              if (w != none)
+                  result.push_back(w);
+          return result;
+      }
+      if (_parent[v] != none)
+          result.push_back(_parent[v]);
+      for (NodeId w = 1; w < _parent.size(); w++)
+          if (_parent[w] == v)
+              result.push_back(w);
+      if (_root_neighbors[0] == v || _root_neighbors[1] == v)
+          result.push_back(0);
+      return result;
+  }
 
-  std::vector<Node> _nodes;
-  std::vector<EdgeId> _edges;
+  //getter functions
+  size_type size() const {
+      return _parent.size();
+  }
+  size_type get_num_edges() const {
+      return _num_edges;
+  }
+  size_type degree(NodeId v) const {
+      return _degree[v];
+  }
+  const std::vector<size_type> &degrees() const {
+      return _degree;
+  }
+  NodeId parent(NodeId v) const {
+      return _parent[v];
+  }
+  const NodeId *root_neighbors() const {
+      return _root_neighbors;
+  }
 
-  size_type num_edges;
-  size_type num_nodes;
+ private:
+  std::vector<NodeId> _parent;
+  std::vector<size_type> _degree;
+  NodeId _root_neighbors[2];
+  size_type _num_edges;
 };
 
 }
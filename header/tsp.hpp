@@ -23,8 +23,18 @@
 #include <numeric>
 #include <utility>
 #include <cassert>
+#include <cstdint>
+#include <memory>
 #include "util.hpp"
+#include "graph.hpp"
 #include "tree.hpp"
+#include "work_stealing.hpp"
+#include "kdtree.hpp"
+#include "edge_status.hpp"
+#include "constraints.hpp"
+#include "step_policy.hpp"
+#include "checkpoint.hpp"
+#include "heuristic.hpp"
 
 #define EPS 10e-7
 
@@ -38,6 +48,85 @@ using size_type = std::size_t;
 using NodeId = size_type;
 using EdgeId = size_type;
 
+/**
+ * How an Instance provides its distances. Either they are computed once and stored in a matrix
+ * (quadratic memory) or computed from the coordinates whenever they are needed (linear memory).
+ * automatic uses the matrix up to max_matrix_dimension nodes.
+ */
+enum class DistanceMode { matrix, coordinates, automatic };
+
+/**
+ * Largest dimension for which DistanceMode::automatic stores the distance matrix,
+ * that are about 400MB of doubles
+ */
+const size_type max_matrix_dimension = 10000;
+
+/**
+ * The edges left by the elimination are used as a sparse graph, see Instance::reduced_graph(), if they are
+ * at most a 1/sparse_graph_factor of all edges. Otherwise the 1-trees on all edges are as fast.
+ */
+const size_type sparse_graph_factor = 4;
+
+/**
+ * Sparse candidate graphs the subgradient method of Held_Karp may run on. nearest takes the k nearest
+ * neighbors of every node, quadrant the k/4 nearest ones in each quadrant around it (filled up with the
+ * nearest ones).
+ */
+enum class CandidateType { none, nearest, quadrant };
+
+/**
+ * When the children of a BranchingNode are bounded. eager runs Held_Karp as soon as they are created,
+ * lazy queues them with the bound of their parent and runs Held_Karp when they are popped. Then the
+ * children which are pruned by a tour found in the meantime are never bounded.
+ */
+enum class Bounding { eager, lazy };
+
+/**
+ * Counters of a branch and bound run. Every worker keeps its own, they are summed at the end.
+ */
+struct SearchStatistics {
+  /// bounded BranchingNodes, including the root and those pruned while bounding
+  size_type nodes = 0;
+  /// 1-trees computed by their Held_Karp calls, and those of the root alone
+  size_type one_trees = 0, root_one_trees = 0;
+  /// lazily bounded nodes which were discarded unbounded, on pop or when a better tour was found, and
+  /// those queued again after bounding
+  size_type unbounded = 0, requeued = 0;
+  /// open nodes dropped at once because a better tour was found
+  size_type dropped = 0;
+  /// largest number of open nodes at a time
+  size_type max_open = 0;
+  /// open nodes written to the spill file
+  size_type spilled = 0;
+  /// 1-trees repaired into tours, and those tours which improved the upper bound
+  size_type repairs = 0, repaired = 0;
+  /// children discarded before bounding since no tour respects their constraints
+  size_type infeasible = 0;
+
+  void add(const AscentState &ascent) {
+      nodes++;
+      one_trees += ascent.iterations;
+  }
+  void add_root(const AscentState &ascent) {
+      add(ascent);
+      root_one_trees += ascent.iterations;
+  }
+  SearchStatistics &operator+=(const SearchStatistics &rhs) {
+      nodes += rhs.nodes;
+      one_trees += rhs.one_trees;
+      root_one_trees += rhs.root_one_trees;
+      unbounded += rhs.unbounded;
+      requeued += rhs.requeued;
+      dropped += rhs.dropped;
+      max_open = std::max(max_open, rhs.max_open);
+      spilled += rhs.spilled;
+      repairs += rhs.repairs;
+      repaired += rhs.repaired;
+      infeasible += rhs.infeasible;
+      return *this;
+  }
+};
+
 template<class coord_type, class dist_type>
 class BranchingNode;
 
@@ -56,26 +145,46 @@ class Instance {
    * Constructor of @class Instance which takes the filename as an argument.
    * File has to be in TSPLIB format
    * @param filename
+   * @param mode whether distances are stored or computed on demand
    */
-  Instance(const std::string &filename);
+  Instance(const std::string &filename, DistanceMode mode = DistanceMode::automatic);
 
   /**
-   *  Distance function in the TSP Instance. Could be also made private, since it's only there
-   *  at init point.
+   *  Distance function in the TSP Instance. Used at init point for the matrix or, if there is
+   *  none, on every weight request.
    * @param x1
    * @param y1
    * @param x2
    * @param y2
    * @return  rounded \f$ \sqrt{(x_1 - x_2)^2  + (y_1 - y_2)^2}\f$
    */
-  dist_type distance(coord_type x1, coord_type y1, coord_type x2, coord_type y2) {
+  dist_type distance(coord_type x1, coord_type y1, coord_type x2, coord_type y2) const {
       return std::lround(std::sqrt((x1 - x2) * (x1 - x2) + (y1 - y2) * (y1 - y2)));
   }
 
   /**
    * Computes and optimal tour on this Instance and saves it as EdgeIds in _tour
+   * @param num_threads number of workers searching the B'n'B tree. For more than one worker, the
+   * search is run in parallel, where every worker has its own queue and steals from the others if
+   * its queue runs empty
    */
-  void compute_optimal_tour();
+  void compute_optimal_tour(size_type num_threads = 1);
+
+  /**
+   * Builds the candidate graph from the spatial index in O(n k log n): the chosen neighbors of every
+   * node, made symmetric. Once there is a candidate graph, the root Held-Karp bound runs its iterations
+   * on it (and adds the edges it misses, see Held_Karp).
+   * @param type CandidateType::none removes the candidate graph
+   * @param k number of candidates chosen per node
+   */
+  void build_candidate_graph(CandidateType type, size_type k);
+
+  /**
+   * @param rule step size rule of the subgradient method in Held_Karp
+   */
+  void set_step_rule(StepRule rule) {
+      _step_rule = rule;
+  }
 
   /**
    * Output the optimal tour into a file by TSPLIB rules
@@ -90,22 +199,285 @@ class Instance {
   }
 
   size_type num_edges() const {
-      return _weights.size();
+      return dimension * (dimension - 1) / 2;
   }
 
   dist_type weight(EdgeId id) const {
-      return _weights.at(id);
+      if (_mode == DistanceMode::matrix)
+          return _weights.at(id);
+      NodeId i = 0, j = 0;
+      to_NodeId(id, i, j, dimension);
+      return distance(_x[i], _y[i], _x[j], _y[j]);
+  }
+
+  /**
+   * weight of the edge {i,j}, i != j
+   */
+  dist_type weight(NodeId i, NodeId j) const {
+      if (_mode == DistanceMode::matrix)
+          return _weights[to_EdgeId(i, j, dimension)];
+      return distance(_x[i], _y[i], _x[j], _y[j]);
   }
 
+  /**
+   * writes the weights of all edges {u,i} to row[i], row[u] is set to 0
+   * @param u
+   * @param row array of size size()
+   */
+  void weight_row(NodeId u, dist_type *row) const;
+
+  /**
+   * @return the stored weights, empty in DistanceMode::coordinates
+   */
   const std::vector<dist_type> &weights() const {
       return _weights;
   }
+
+  /**
+   * @return either DistanceMode::matrix or DistanceMode::coordinates
+   */
+  DistanceMode distance_mode() const {
+      return _mode;
+  }
+
+  bool has_candidate_graph() const {
+      return !_candidates.empty() && !_candidates.front().empty();
+  }
+  /**
+   * @return counters of the last compute_optimal_tour
+   */
+  const SearchStatistics &statistics() const {
+      return _statistics;
+  }
+
+  /**
+   * @param bounding when the children of a BranchingNode are bounded
+   */
+  void set_bounding(Bounding bounding) {
+      _bounding = bounding;
+  }
+  Bounding bounding() const {
+      return _bounding;
+  }
+
+  /**
+   * @param bytes memory the open nodes may take, 0 for no limit. Above it, the open nodes of the worst
+   * bounds are moved to a temporary spill file and read back when the open nodes in memory run low.
+   */
+  void set_memory_limit(size_type bytes) {
+      _memory_limit = bytes;
+  }
+  size_type memory_limit() const {
+      return _memory_limit;
+  }
+
+  /**
+   * @param filename where compute_optimal_tour writes checkpoints, empty for none. The last one is
+   * written when the search is done.
+   * @param interval seconds between two checkpoints
+   */
+  void set_checkpoint(const std::string &filename, double interval = 600.) {
+      _checkpoint_file = filename;
+      _checkpoint_interval = interval;
+  }
+
+  /**
+   * @param filename checkpoint compute_optimal_tour continues from instead of bounding the root, empty
+   * for none. It has to be taken on the same instance.
+   */
+  void set_resume_file(const std::string &filename) {
+      _resume_file = filename;
+  }
+
+  /**
+   * @param heuristic whether compute_optimal_tour starts from the tour of greedy_tour improved by
+   * LocalSearch. Its length is the first upper bound, also the target of the root ascent. Once the root
+   * is bounded, Lin-Kernighan steps on its alpha-nearness candidates improve the tour further.
+   */
+  void set_heuristic(bool heuristic) {
+      _heuristic = heuristic;
+  }
+  bool heuristic() const {
+      return _heuristic;
+  }
+
+  /**
+   * @param interval the 1-tree of every interval-th bounded node is repaired into a tour, see
+   * repair_tour(), and polished by 2-opt and Or-opt under the node's constraints. 0 for none.
+   * @param depth the nodes up to this many branchings below the root are repaired in any case (unless
+   * interval is 0), where the trees differ most
+   */
+  void set_tour_repair(size_type interval, size_type depth) {
+      _repair_interval = interval;
+      _repair_depth = depth;
+  }
+
+  /**
+   * @return the multipliers of the root of the last compute_optimal_tour
+   */
+  const std::vector<double> &root_lambda() const {
+      return _root_lambda;
+  }
+
+  /**
+   * @return either StepRule::linear or StepRule::polyak
+   */
+  StepRule step_rule() const {
+      if (_step_rule == StepRule::automatic)
+          return size() <= max_linear_dimension ? StepRule::linear : StepRule::polyak;
+      return _step_rule;
+  }
+  /**
+   * Edges whose bound, i.e. the root bound plus their alpha-nearness for the root multipliers, reaches the
+   * best tour cannot be in a shorter one. They are eliminated for the whole search, see eliminate_edges().
+   * @return neighbor lists of the remaining edges, nullptr while all edges are considered. It is replaced,
+   * not changed, once the tour improves, so it can be used by one thread while another one improves it.
+   */
+  std::shared_ptr<const std::vector<std::vector<NodeId> > > reduced_graph() const {
+      return std::atomic_load(&_reduced_graph);
+  }
+
+  /**
+   * @return sorted neighbor lists of the candidate graph
+   */
+  const std::vector<std::vector<NodeId> > &candidates() const {
+      return _candidates;
+  }
+
+  /**
+   * @return k-d tree over the coordinates for nearest neighbor and radius queries
+   */
+  const KdTree<coord_type> &spatial_index() const {
+      return _spatial_index;
+  }
+
+  const std::vector<coord_type> &x() const {
+      return _x;
+  }
+  const std::vector<coord_type> &y() const {
+      return _y;
+  }
   const dist_type & length() {
       return _length;
   }
  private:
+  /**
+   * Best-first search with a single priority queue
+   */
+  void search_serial();
+  /**
+   * Best-first search of @p num_threads workers with work stealing. The upper bound is shared among
+   * them, the tour is protected by a mutex.
+   * @param num_threads
+   */
+  void search_parallel(size_type num_threads);
+
+  /**
+   * prints the statistics to std::cerr
+   */
+  void print_statistics() const;
+
+  /**
+   * @param upper_bound length of the best tour so far
+   * @return a checkpoint of the tour and the root multipliers, the caller adds the open nodes
+   */
+  Checkpoint<BranchingNode<coord_type, dist_type>, dist_type> make_checkpoint(dist_type upper_bound) const;
+
+  /**
+   * reads the checkpoint _resume_file, sets the root multipliers and its tour, if it is shorter
+   * @param upper_bound length of the tour so far
+   * @param on_node called with every open node
+   * @return the length of the shorter tour, max() if there is none
+   */
+  template<class Function>
+  dist_type resume(dist_type upper_bound, Function on_node);
+
+  /**
+   * runs the primal heuristics, if enabled, and sets the tour
+   * @return the length of the tour, max() if there is none
+   */
+  dist_type initial_tour();
+
+  /**
+   * computes the minimum 1-tree for root_lambda() on all edges, which improve_tour() and eliminate_edges()
+   * start from, and drops the edges eliminated so far
+   * @param constraints space for the (empty) constraints of the root
+   * @param tree space for the 1-tree
+   */
+  void compute_root_tree(Constraints &constraints, OneTree &tree);
+
+  /**
+   * improves the tour by LocalSearch with Lin-Kernighan steps and kicks on the alpha-nearness candidates
+   * of the root 1-tree, if the heuristics are enabled
+   * @param upper_bound length of the tour
+   * @return the length of the improved tour
+   */
+  dist_type improve_tour(dist_type upper_bound);
+
+  /**
+   * eliminates the edges which cannot be in a tour shorter than upper_bound by their alpha-nearness in
+   * the root 1-tree, in O(n^2). The remaining ones become reduced_graph(), if they are few enough, see
+   * sparse_graph_factor. Otherwise all edges are kept and nothing is reported.
+   * @param upper_bound length of the best tour
+   */
+  void eliminate_edges(dist_type upper_bound);
+
+  /**
+   * @param tree e.g. a 1-tree which is a tour
+   * @return the sum of the weights of its edges
+   */
+  dist_type tree_length(const OneTree &tree) const;
+
+  /**
+   * @param node a bounded node
+   * @param count number of bounded nodes so far, increased by one
+   * @return true, if the 1-tree of node is to be repaired, see set_tour_repair()
+   */
+  bool repair_due(const BranchingNode<coord_type, dist_type> &node, size_type &count) const;
+
+  /**
+   * drops the open nodes which cannot lead to a tour shorter than upper_bound. With Bounding::lazy, the
+   * unbounded ones among them are counted as SearchStatistics::unbounded, all of them as dropped.
+   * @param Q open list, a SpillingQueue or WorkStealingQueues
+   * @param upper_bound length of the best tour
+   * @param statistics counters of the calling worker
+   * @return number of dropped nodes
+   */
+  template<class Queue>
+  size_type prune_open(Queue &Q, dist_type upper_bound, SearchStatistics &statistics) const;
+
+  /**
+   * repairs a 1-tree into a tour and polishes it
+   * @param tree the 1-tree of a node
+   * @param constraints the constraints of the node
+   * @param order placeholder for the order in which the tour visits the nodes
+   * @return the length of the tour, max() if there is none
+   */
+  dist_type repair(const OneTree &tree, const Constraints &constraints, std::vector<NodeId> &order) const;
+
   std::vector<NodeId> _nodes;
+  // weights of the upper triangle only, indexed by EdgeId (see util.hpp). Empty without a matrix
   std::vector<dist_type> _weights;
+  std::vector<coord_type> _x, _y;
+  DistanceMode _mode;
+  std::vector<std::vector<NodeId> > _candidates;
+  KdTree<coord_type> _spatial_index;
+  StepRule _step_rule = StepRule::automatic;
+  Bounding _bounding = Bounding::eager;
+  size_type _memory_limit = 0;
+  std::string _checkpoint_file, _resume_file;
+  double _checkpoint_interval = 600.;
+  bool _heuristic = true;
+  size_type _repair_interval = 10, _repair_depth = 5;
+  // candidate lists of the local search, nearest neighbors or, after improve_tour, alpha-nearness
+  std::vector<std::vector<NodeId> > _tour_neighbors;
+  std::vector<double> _root_lambda;
+  OneTree _root_tree = OneTree(0);
+  // see reduced_graph(), only accessed by std::atomic_load and std::atomic_store
+  std::shared_ptr<const std::vector<std::vector<NodeId> > > _reduced_graph;
+  // fraction of the edges missing from _reduced_graph, 0 while there is none
+  double _eliminated = 0.;
+  SearchStatistics _statistics;
   size_type dimension;
   std::vector<NodeId> _tour;
   dist_type _length;
@@ -113,10 +485,11 @@ class Instance {
 
 /**
  * @class BranchingNode represents a Node in our branch and bound tree. It contains the
- * lower bound for itself and saves temporary information as tree, lambda, required, forbidden.
- * @comment Yeah, for the different branching nodes and their 'to append' edges, we implemented
- * separate constructors. It could be achieved by one, but this was easier, as we are
- * lacking some structures necessary for this. - Alex
+ * lower bound for itself and the multipliers its children start from. Its required and forbidden edges
+ * are only stored as the decisions it added to those of its parent, the parent's ones are shared via a
+ * ref-counted DecisionList. The full Constraints and the 1-tree are rebuilt when the node is expanded,
+ * see rebuild() and get_tree(), so an open node costs its own decisions and its multipliers only.
+ * BranchingNodes are move-only, the open list moves them into a NodePool and out again.
  * @tparam coord_type Container in which the Coordinates are given. Assumably double
  * @tparam dist_type Container in which the distances  are given. Assumably double
  */
@@ -124,84 +497,101 @@ template<class coord_type, class dist_type>
 class BranchingNode {
  public:
   /**
-   * First Constructor: Constructs a BranchingNode without any forbidden or required edges,
-   * i.e. the root of our B'n'B tree.
+   * Constructs an empty placeholder, which is only good for being assigned to
+   */
+  BranchingNode() = default;
+  /**
+   * First Constructor: Constructs and bounds a BranchingNode without any forbidden or required edges,
+   * i.e. the root of our B'n'B tree. The other constructor leaves the bounding to bound().
    * @param tsp The TSP Instance
+   * @param constraints scratch space, reset to no constraints
+   * @param tree receives the 1-tree of the bound
+   * @param upper_bound length of the best known tour, see is_pruned()
    */
-  BranchingNode(const Instance<coord_type, dist_type> &tsp
-  ) : size(tsp.size()), required(), required_neighbors(size), forbidden(),
-      forbidden_neighbors(size), lambda(size, 0), tree(size) {
-      HK = Held_Karp(tsp, this->lambda, this->tree, *this, true);
+  BranchingNode(const Instance<coord_type, dist_type> &tsp,
+                Constraints &constraints,
+                OneTree &tree,
+                dist_type upper_bound = std::numeric_limits<dist_type>::max()
+  ) : lambda(std::make_shared<const std::vector<double> >(tsp.size(), 0)) {
+      constraints.reset();
+      bound(tsp, constraints, tree, upper_bound, true);
   }
   /**
-   * Second Constructor: Constructs a BranchingNode with \f$ F := F \cup e_1 \f$
-   * @param BNode predecessor BranchingNode
-   * @param tsp The TSP Instance
-   * @param e1 additional edge for forbidden edges
+   * Second Constructor: Constructs an unbounded child of a BranchingNode. It starts from the multipliers
+   * and the bound of its parent.
+   * @param parent predecessor BranchingNode
+   * @param added the required and forbidden edges the child adds, including the implied ones (see
+   * Constraints::set_log)
    */
-  BranchingNode(const BranchingNode<coord_type, dist_type> &BNode,
-                const Instance<coord_type, dist_type> &tsp,
-                EdgeId e1
-  ) : size(tsp.size()),
-      required(BNode.get_required()),
-      required_neighbors(BNode.required_neighbors),
-      forbidden(BNode.get_forbidden()),
-      forbidden_neighbors(BNode.forbidden_neighbors),
-      lambda(BNode.get_lambda()),
-      tree(tsp.size()) {
+  BranchingNode(const BranchingNode<coord_type, dist_type> &parent,
+                std::vector<Decision> &&added
+  ) : decisions(std::make_shared<const DecisionList>(DecisionList{parent.decisions, std::move(added)})),
+      lambda(parent.lambda),
+      ascent(parent.ascent),
+      HK(parent.HK),
+      level(parent.level + 1),
+      bounded(false),
+      pruned(false) {}
 
-      add_forbidden(e1);
-      HK = Held_Karp(tsp, this->lambda, this->tree, *this);
-  }
   /**
-   * Third Constructor: Constructs a BranchingNode with \f$ R := R \cup {e_1} F := F \cup {e_2} \f$
-   * @param BNode predecessor BranchingNode
-   * @param tsp The TSP Instance
-   * @param e1 additional edge for required edges
-   * @param e2 additional edge for forbidden edges
-   */
-  BranchingNode(const BranchingNode<coord_type, dist_type> &BNode,
-                const Instance<coord_type, dist_type> &tsp,
-                EdgeId e1,
-                EdgeId e2
-  ) : size(tsp.size()),
-      required(BNode.get_required()),
-      required_neighbors(BNode.required_neighbors),
-      forbidden(BNode.get_forbidden()),
-      forbidden_neighbors(BNode.forbidden_neighbors),
-      lambda(BNode.get_lambda()),
-      tree(tsp.size()) {
-      add_required(e1);
-      add_forbidden(e2);
-      HK = Held_Karp(tsp, this->lambda, this->tree, *this);
-  }
-  /**
-   * Fourth Constructor: Constructs a BranchingNode with \f$ R := R \cup {e_1 } \cup {e_2}\f$
-   * @param BNode predecessor BranchingNode
-   * @param tsp The TSP Instance
-   * @param e1 additional edge for required edges
-   * @param e2 additional edge for forbidden edges
-   * @param both_req bool to distinguish third from forth constructor
-   */
-  BranchingNode(const BranchingNode<coord_type, dist_type> &BNode,
-                const Instance<coord_type, dist_type> &tsp,
-                EdgeId e1,
-                EdgeId e2,
-                bool both_req
-  ) : size(tsp.size()),
-      required(BNode.get_required()),
-      required_neighbors(BNode.required_neighbors),
-      forbidden(BNode.get_forbidden()),
-      forbidden_neighbors(BNode.forbidden_neighbors),
-      lambda(BNode.get_lambda()),
-      tree(tsp.size()) {
-
-      if (both_req) {
-          add_required(e1);
-          add_required(e2);
+   * Third Constructor: Reads a BranchingNode written by save(). All its decisions are in one list then.
+   * @param in
+   */
+  explicit BranchingNode(std::istream &in) : BranchingNode(in, 0) {}
+
+  /**
+   * Fourth Constructor: As above, but checks that the node is one of an instance with @p dimension nodes,
+   * e.g. if it is read from a file another run has written
+   * @param in
+   * @param dimension number of nodes of the instance, 0 to skip the checks
+   * @throws std::runtime_error if the number of multipliers is not dimension, there are more decisions than
+   * edges or a decision is on no edge or neither requires nor forbids it
+   */
+  BranchingNode(std::istream &in, size_type dimension) {
+      std::uint64_t num_nodes = 0, num_decisions = 0;
+      char flags = 0;
+      read_binary(in, HK);
+      read_binary(in, flags);
+      read_binary(in, ascent);
+      read_binary(in, num_nodes);
+      level = num_nodes;
+      read_binary(in, num_nodes);
+      if (dimension > 0 && num_nodes != dimension)
+          throw std::runtime_error("Node has " + std::to_string(num_nodes) + " multipliers, but the instance has "
+                                       + std::to_string(dimension) + " nodes");
+      std::shared_ptr<std::vector<double> > multipliers = std::make_shared<std::vector<double> >(num_nodes);
+      for (auto &el : *multipliers)
+          read_binary(in, el);
+      read_binary(in, num_decisions);
+      const std::uint64_t num_edges = dimension * (dimension - 1) / 2;
+      if (dimension > 0 && num_decisions > num_edges)
+          throw std::runtime_error("Node has " + std::to_string(num_decisions) + " decisions, but the instance has "
+                                       + std::to_string(num_edges) + " edges");
+      if (num_decisions > 0) {
+          std::shared_ptr<DecisionList> list = std::make_shared<DecisionList>();
+          list->decisions.resize(num_decisions);
+          for (auto &el : list->decisions) {
+              std::uint64_t edge = 0;
+              std::uint8_t status = 0;
+              read_binary(in, edge);
+              read_binary(in, status);
+              if (dimension > 0 && (edge >= num_edges || (status != EdgeStatus::REQUIRED
+                                                          && status != EdgeStatus::FORBIDDEN)))
+                  throw std::runtime_error("Node has an invalid decision on edge " + std::to_string(edge));
+              el = Decision(edge, static_cast<EdgeStatus::Status>(status));
+          }
+          decisions = std::move(list);
       }
-      HK = Held_Karp(tsp, this->lambda, this->tree, *this);
+      lambda = std::move(multipliers);
+      bounded = flags & 1;
+      pruned = flags & 2;
   }
+
+  BranchingNode(const BranchingNode<coord_type, dist_type> &) = delete;
+  BranchingNode &operator=(const BranchingNode<coord_type, dist_type> &) = delete;
+  BranchingNode(BranchingNode<coord_type, dist_type> &&) = default;
+  BranchingNode &operator=(BranchingNode<coord_type, dist_type> &&) = default;
+
   /**
    * Overloading operator > and comparing lowerbounds of two BranchingNodes.
    * Used by priority_queue
@@ -211,129 +601,147 @@ class BranchingNode {
   bool operator>(const BranchingNode<coord_type, dist_type> &rhs) const;
 
   /**
-   * For an EdgeId e corresponding to an edge (i,j) it returns the edge
-   * corresponding to the edge (j,i)
-   * @param e \f$ =(i,j)\f$
-   * @param n size on the tsp instance
-   * @return \f$(j,i) = e' \f$
+   * sets @p constraints to the required and forbidden edges of this node
    */
-  EdgeId reverse_edge(EdgeId e, size_type n) const {
-      NodeId i = 0, j = 0;
-      to_NodeId(e, i, j, n);
-      return j * n + i;
+  void rebuild(Constraints &constraints) const {
+      constraints.replay(decisions.get());
   }
 
   /**
-   *
-   * @param id EdgeId id
-   * @return true, if the undirected edge {i,j} is required, else false
-   */
-  bool is_required(EdgeId id) const {
-      return (std::find(required.begin(), required.end(), id) != required.end()
-          && std::find(required.begin(), required.end(), reverse_edge(id, size)) != required.end());
-  }
-   /**
-   *
-   * @param id EdgeId id
-   * @return true, if the undirected edge {i,j} is forbidden, else false
+   * @return a copy which shares the multipliers and the decisions with this node. They are never
+   * changed once the node exists, so the copy may be read by another thread, e.g. to write a checkpoint.
    */
-  bool is_forbidden(EdgeId id) const {
-      return (std::find(forbidden.begin(), forbidden.end(), id) != forbidden.end()
-          && std::find(forbidden.begin(), forbidden.end(), reverse_edge(id, size)) != forbidden.end());
+  BranchingNode share() const {
+      BranchingNode copy;
+      copy.decisions = decisions;
+      copy.lambda = lambda;
+      copy.ascent = ascent;
+      copy.HK = HK;
+      copy.level = level;
+      copy.bounded = bounded;
+      copy.pruned = pruned;
+      return copy;
   }
 
   /**
-   * forbids all edges incident to idx except e1,e2
-   * @param idx
-   * @param e1
-   * @param e2
+   * writes the node in compact form, i.e. its bound, depth, multipliers and the decisions of it and all
+   * its ancestors, see the third constructor
+   * @param out
    */
-  void forbid(NodeId idx, EdgeId e1, EdgeId e2) ;
-
-  /**
-   * adds non-forbidden edges of incident edges of idx to required
-   * @param idx
-   */
-  void admit(NodeId idx) ;
+  void save(std::ostream &out) const {
+      write_binary(out, HK);
+      write_binary(out, char((bounded ? 1 : 0) | (pruned ? 2 : 0)));
+      write_binary(out, ascent);
+      write_binary(out, std::uint64_t(level));
+      write_binary(out, std::uint64_t(lambda->size()));
+      for (const auto &el : *lambda)
+          write_binary(out, el);
+      std::vector<const DecisionList *> path;
+      std::uint64_t num_decisions = 0;
+      for (const DecisionList *list = decisions.get(); list; list = list->parent.get()) {
+          path.push_back(list);
+          num_decisions += list->decisions.size();
+      }
+      write_binary(out, num_decisions);
+      for (auto it = path.rbegin(); it != path.rend(); ++it)
+          for (const auto &el : (*it)->decisions) {
+              write_binary(out, std::uint64_t(el.first));
+              write_binary(out, std::uint8_t(el.second));
+          }
+  }
 
   /**
-   * pushes both, e and reverse edge of e to required
-   * @param e
-   * @return false, if it was already in required
+   * @return estimated number of bytes of the node, its multipliers and its own decisions. The
+   * multipliers are counted even if they are shared with the parent, the decisions of the ancestors not.
    */
-  bool push_required(EdgeId e);
+  size_type memory() const {
+      size_type bytes = sizeof(*this) + (lambda ? sizeof(*lambda) + lambda->capacity() * sizeof(double) : 0);
+      if (decisions)
+          bytes += sizeof(*decisions) + decisions->decisions.capacity() * sizeof(Decision);
+      return bytes;
+  }
 
   /**
-   * external function to add an edge e to required
-   * @param e
+   * @return number of branchings between the root and this node
    */
-  void add_required(EdgeId e) ;
+  size_type depth() const {
+      return level;
+  }
 
   /**
-   * pushes both, e and reverse edge of e to forbidden
-   * @param e
-   * @return false, if it was already forbidden
-   */
-  bool push_forbidden(EdgeId e);
-  /**
-   * external function to add an edge e to forbidden
-   * @param e
+   * @return the decisions this node added to those of its parent, nullptr for the root
    */
-  void add_forbidden(EdgeId e);
-
+  const DecisionList *get_decisions() const {
+      return decisions.get();
+  }
 
   //Getter functions
-  const std::vector<EdgeId> &get_required() const {
-      return required;
-  }
-  const std::vector<EdgeId> &get_forbidden() const {
-      return forbidden;
+  const std::vector<double> &get_lambda() const {
+      return *lambda;
   }
 
-  const std::vector<dist_type> &get_lambda() const {
-      return lambda;
-  }
-  std::vector<dist_type> &get_lambda() {
-      return lambda;
+  /**
+   * computes the 1-tree of the bound, i.e. the minimum 1-tree for get_lambda()
+   * @param tsp The TSP Instance
+   * @param constraints the constraints of this node, see rebuild()
+   * @param tree space to save the tree
+   * @return false, if there is none on the edges left by the elimination, see Instance::reduced_graph().
+   * Then the node can be discarded.
+   */
+  bool get_tree(const Instance<coord_type, dist_type> &tsp, const Constraints &constraints, OneTree &tree) const {
+      tree.clear();
+      return compute_minimal_1_tree(tree, *lambda, tsp, constraints);
   }
 
-  const OneTree &get_tree() const {
-      return tree;
-  }
-  OneTree &get_tree() {
-      return tree;
+  const AscentState &get_ascent() const {
+      return ascent;
   }
 
   const dist_type get_HK() const {
       return this->HK;
   }
-
-  const std::vector<Node> &get_required_neighbors() const {
-      return required_neighbors;
+  /**
+   * computes the lower bound get_HK() by Held_Karp, stops as soon as it reaches upper_bound
+   * @param tsp The TSP Instance
+   * @param constraints the constraints of this node, see rebuild()
+   * @param tree receives the 1-tree of the bound
+   * @param upper_bound length of the best known tour, see is_pruned()
+   * @param root true for the root of the B'n'B tree
+   */
+  void bound(const Instance<coord_type, dist_type> &tsp, const Constraints &constraints, OneTree &tree,
+             dist_type upper_bound, bool root = false) {
+      std::shared_ptr<std::vector<double> > multipliers = std::make_shared<std::vector<double> >(*lambda);
+      HK = Held_Karp(tsp, *multipliers, this->ascent, tree, constraints, root, upper_bound);
+      lambda = std::move(multipliers);
+      bounded = true;
+      pruned = HK >= upper_bound;
   }
   /**
-   * checks if the current tree is 2-regular
-   * @return true, if T 2-regular
+   * @return false, if bound() was not called yet. Then get_HK() and get_lambda() are those of the parent.
    */
-  bool tworegular() {
-      for (const auto &el : tree.get_nodes())
-          if (el.degree() != 2)
-              return false;
-      return true;
+  bool is_bounded() const {
+      return bounded;
+  }
+  /**
+   * @return true, if the lower bound reached the upper bound given to bound(). Then Held_Karp
+   * stopped early, so get_HK() may be smaller than the full bound, but the node can be discarded anyway.
+   */
+  bool is_pruned() const {
+      return pruned;
   }
 
  private:
-  size_type size;
-  std::vector<EdgeId> required;
-  std::vector<Node> required_neighbors;
-
-  std::vector<EdgeId> forbidden;
-  std::vector<Node> forbidden_neighbors;
-
-  std::vector<double> lambda;
-  OneTree tree;
-
-  dist_type HK;
+  // the decisions of this node on top of those of its ancestors, nullptr for the root
+  std::shared_ptr<const DecisionList> decisions;
+  // shared with the parent until the node is bounded
+  std::shared_ptr<const std::vector<double> > lambda;
+  AscentState ascent;
+
+  dist_type HK = 0;
+  // see depth(), kept apart from the decisions since save() puts them all into one list
+  size_type level = 0;
+  bool bounded = false;
+  bool pruned = false;
 };
 }
 
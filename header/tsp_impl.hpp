@@ -20,103 +20,474 @@
 #include <sstream>
 #include <queue>
 #include <numeric>
+#include <atomic>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+#include <cstdint>
+#include <initializer_list>
 #include "tree.hpp"
+#include "constraints.hpp"
+#include "simd.hpp"
+#include "step_policy.hpp"
 
 namespace TSP {
 
 /**
- * computes a minimum-1-tree for a given BranchingNode
+ * @class ModifiedWeights gives the modified weights \f$ c_\lambda(i,j) = c(i,j) + \lambda_i + \lambda_j \f$ of
+ * a BranchingNode without storing them. Required edges get the weight -inf, forbidden ones +inf, which
+ * is looked up in the EdgeStatus of the node.
  * @tparam coord_type
  * @tparam dist_type
- * @param tree space to save the optimal tree
- * @param lambda if we are in the root node, we'll save our holy lambda here, else it's just the root lambda
- * @param tsp The TSP Instance
- * @param BNode the correspnding BranchingNode
  */
 template<class coord_type, class dist_type>
-void compute_minimal_1_tree(TSP::OneTree &tree,
-                            const std::vector<double> &lambda,
-                            const TSP::Instance<coord_type, dist_type> &tsp,
-                            const TSP::BranchingNode<coord_type, dist_type> &BNode) {
+class ModifiedWeights {
+ public:
+  /**
+   * @param tsp The TSP Instance
+   * @param lambda
+   * @param status required and forbidden edges
+   * @param required_neighbors required edges as neighbor lists
+   */
+  ModifiedWeights(const TSP::Instance<coord_type, dist_type> &tsp,
+                  const std::vector<double> &lambda,
+                  const EdgeStatus &status,
+                  const std::vector<Node> &required_neighbors)
+      : _tsp(tsp), _lambda(lambda), _status(status), _required_neighbors(required_neighbors) {}
+
+  /**
+   * @param u
+   * @param i
+   * @return modified weight of {u,i}
+   */
+  dist_type operator()(NodeId u, NodeId i) const {
+      switch (_status.get(to_EdgeId(u, i, _tsp.size()))) {
+          case EdgeStatus::REQUIRED: return required_weight();
+          case EdgeStatus::FORBIDDEN: return forbidden_weight();
+          default: return _tsp.weight(u, i) + _lambda[u] + _lambda[i];
+      }
+  }
+
+  /**
+   * computes the modified weights of all edges {u,i} at once. Entry u is \f$ \lambda_u \f$ and the
+   * lambda of the other end node is left out, i.e. \f$ row_i + \lambda_i = c_\lambda(u,i) \f$ for
+   * unconstrained edges
+   * @param u
+   * @param row array of size n
+   */
+  void fill_row(NodeId u, dist_type *row) const {
+      TSP::size_type n = _tsp.size();
+      _tsp.weight_row(u, row);
+      for (NodeId i = 0; i < n; i++)
+          row[i] += _lambda[u];
+      auto patch = [&](NodeId i, EdgeStatus::Status status) {
+          row[i] = (status == EdgeStatus::REQUIRED) ? required_weight() : forbidden_weight();
+      };
+      // column u of the upper triangle edge by edge ..
+      EdgeId edge = u - 1;
+      for (NodeId i = 0; i < u; i++) {
+          EdgeStatus::Status status = _status.get(edge);
+          if (status != EdgeStatus::FREE)
+              patch(i, status);
+          edge += n - i - 2;
+      }
+      // .. row u word by word
+      EdgeId begin = row_offset(u, n);
+      _status.for_each_constrained(begin, row_offset(u + 1, n), [&](EdgeId e, EdgeStatus::Status status) {
+          patch(u + 1 + (e - begin), status);
+      });
+  }
+
+  const std::vector<double> &lambda() const {
+      return _lambda;
+  }
+  const std::vector<Node> &required_neighbors() const {
+      return _required_neighbors;
+  }
+
+  static dist_type required_weight() {
+      return std::numeric_limits<dist_type>::lowest() / 4.;
+  }
+  static dist_type forbidden_weight() {
+      return std::numeric_limits<dist_type>::max();
+  }
+
+ private:
+  const TSP::Instance<coord_type, dist_type> &_tsp;
+  const std::vector<double> &_lambda;
+  const EdgeStatus &_status;
+  const std::vector<Node> &_required_neighbors;
+};
+
+/**
+ * @class HeldKarpWorkspace holds the scratch space of Held_Karp and the 1-tree algorithms. Every thread
+ * has its own one, see local(). The buffers are sized for the instance once and reused afterwards, so
+ * the subgradient loop does not allocate.
+ * @tparam dist_type
+ */
+template<class dist_type>
+class HeldKarpWorkspace {
+ public:
+  typedef std::pair<dist_type, NodeId> HeapEntry;
+
+  /**
+   * @param n size of the instance
+   * @return the workspace of the calling thread, sized for n nodes
+   */
+  static HeldKarpWorkspace &local(size_type n) {
+      static thread_local HeldKarpWorkspace workspace;
+      workspace.resize(n);
+      return workspace;
+  }
+
+  // prim_dense
+  std::vector<dist_type> key, row, offset;
+  std::vector<std::int64_t> parent;
+  // prim_heap, heap is a binary min-heap kept by std::push_heap / std::pop_heap
+  std::vector<NodeId> heap_parent;
+  std::vector<char> contained;
+  std::vector<HeapEntry> heap;
+  // Held_Karp: the current and the previous 1-tree are swapped instead of copied
+  OneTree tree = OneTree(0), previous = OneTree(0), tree_max = OneTree(0), full = OneTree(0),
+      tree_priced = OneTree(0);
+  std::vector<double> lambda, lambda_max, lambda_priced, direction;
+
+ private:
+  void resize(size_type n) {
+      if (tree.size() == n)
+          return;
+      key.assign(n, 0);
+      row.assign(n, 0);
+      offset.assign(n, 0);
+      parent.assign(n, 0);
+      heap_parent.assign(n, 0);
+      contained.assign(n, false);
+      heap.clear();
+      heap.reserve(2 * n);
+      tree = previous = tree_max = full = tree_priced = OneTree(n);
+      lambda.assign(n, 0);
+      lambda_max.assign(n, 0);
+      lambda_priced.assign(n, 0);
+      direction.assign(n, 0);
+  }
+};
 
-    //compute modified weights c_\lambda and set the weight of required edges
-    // to -inf and for forbidden edges to +inf
-    std::vector<dist_type> mod_weights(tsp.num_edges(), 0);
+/**
+ * Algorithms computing the MST on {1,..,n-1} of a minimum 1-tree.
+ * dense scans all nodes for the minimum key in every step, which takes O(n^2) on complete graphs.
+ * heap uses a binary heap, which takes O(m log n) and thus only pays off on sparse graphs.
+ */
+enum class OneTreeEngine { dense, heap };
 
-    for (size_t edge = 0; edge < tsp.weights().size(); edge++) {
-        TSP::NodeId v = 0, w = 0;
-        to_NodeId(edge, v, w, tsp.size());
-        mod_weights.at(edge) = tsp.weight(edge) + lambda[v] + lambda[w];
+/**
+ * For all i < n: relaxes \f$ key_i \f$ by \f$ row_i + offset_i \f$ (and sets \f$ parent_i = u \f$ if it did)
+ * and returns the smallest i of minimum key. This is the generic version, for double the vectorized
+ * kernel from simd.hpp is used.
+ */
+template<class dist_type>
+size_type relax_argmin(const dist_type *row, const dist_type *offset, dist_type *key,
+                       std::int64_t *parent, std::int64_t u, size_type n) {
+    size_type next = n;
+    dist_type next_key = std::numeric_limits<dist_type>::infinity();
+    for (size_type i = 0; i < n; i++) {
+        dist_type weight = row[i] + offset[i];
+        if (weight < key[i]) {
+            key[i] = weight;
+            parent[i] = u;
+        }
+        if (key[i] < next_key) {
+            next_key = key[i];
+            next = i;
+        }
     }
+    return next;
+}
 
-    for (const auto &el : BNode.get_forbidden())
-        mod_weights.at(el) = std::numeric_limits<dist_type>::max();
-    for (const auto &el : BNode.get_required())
-        mod_weights.at(el) = -1; //std::numeric_limits<dist_type>::min();
+inline size_type relax_argmin(const double *row, const double *offset, double *key,
+                              std::int64_t *parent, std::int64_t u, size_type n) {
+    static const simd::RelaxArgminKernel kernel = simd::relax_argmin_kernel();
+    return kernel(row, offset, key, parent, u, n);
+}
 
+/**
+ * computes a MST on {1,..,n-1} by Prim's algorithm with an array of keys and a linear search for
+ * the minimum. Relaxing the edges of the last added node and searching the next one is done by
+ * relax_argmin over the whole arrays: nodes already in the tree (and node 0) have key and offset
+ * +inf, so they are neither relaxed nor chosen.
+ * @tparam coord_type
+ * @tparam dist_type
+ * @param tree space to save the tree
+ * @param weights modified weights
+ * @param n size of the instance
+ * @param ws scratch space
+ * @param adjacency if given, only these edges (and the required ones) are considered, else all edges.
+ * Their weights are scattered into a row of +inf instead of computing the full rows, the search for the
+ * minimum still scans all keys.
+ * @return false, if the considered edges which are not forbidden do not connect {1,..,n-1}
+ */
+template<class coord_type, class dist_type>
+bool prim_dense(TSP::OneTree &tree, const ModifiedWeights<coord_type, dist_type> &weights, TSP::size_type n,
+                HeldKarpWorkspace<dist_type> &ws, const std::vector<std::vector<NodeId> > *adjacency = nullptr) {
+    static_assert(std::numeric_limits<dist_type>::has_infinity, "prim_dense needs a dist_type with infinity");
+    if (n < 3)
+        return true;
+    const dist_type blocked = std::numeric_limits<dist_type>::infinity();
+    std::vector<dist_type> &key = ws.key, &row = ws.row, &offset = ws.offset;
+    std::vector<std::int64_t> &parent = ws.parent;
+    std::fill(key.begin(), key.end(), std::numeric_limits<dist_type>::max());
+    std::copy(weights.lambda().begin(), weights.lambda().end(), offset.begin());
+    std::fill(parent.begin(), parent.end(), 0);
+    if (adjacency)
+        std::fill(row.begin(), row.end(), blocked);
+    // the entries of fill_row for the edges of u, lambda_i is added back as offset
+    auto scatter = [&](NodeId u, bool set) {
+        for (const auto &el : (*adjacency)[u])
+            row[el] = set ? weights(u, el) - weights.lambda()[el] : blocked;
+        for (const auto &el : weights.required_neighbors()[u].neighbors())
+            row[el] = set ? weights(u, el) - weights.lambda()[el] : blocked;
+    };
 
-    // computing a MST on {2,..,n} by PRIM MST Algorithm
-    typedef std::pair<dist_type, int> Pair;
-    //instantiate our priority_queue properly
-    std::priority_queue<Pair, std::vector<Pair>, std::greater<Pair> > pq;
+    bool connected = true;
+    NodeId u = 1; // Start at the first node != 0
+    key[0] = offset[0] = blocked;
+    key[u] = offset[u] = blocked;
+    for (TSP::size_type step = 2; step < n; step++) {
+        if (adjacency)
+            scatter(u, true);
+        else
+            weights.fill_row(u, row.data());
+        NodeId next = relax_argmin(row.data(), offset.data(), key.data(), parent.data(),
+                                   static_cast<std::int64_t>(u), n);
+        if (adjacency)
+            scatter(u, false);
+        connected = connected && key[next] < std::numeric_limits<dist_type>::max();
+        key[next] = offset[next] = blocked;
+        tree.set_parent(next, static_cast<NodeId>(parent[next]));
+        u = next;
+    }
+    return connected;
+}
 
-    int src = 1; // Start at the first node != 0
-    TSP::size_type n = tsp.size();
+/**
+ * computes a MST on {1,..,n-1} by Prim's algorithm with a binary heap and lazy deletion
+ * @tparam coord_type
+ * @tparam dist_type
+ * @param tree space to save the tree
+ * @param weights modified weights
+ * @param n size of the instance
+ * @param ws scratch space
+ * @param adjacency if given, only these edges (and the required ones) are considered, else all edges
+ * @return false, if the considered edges do not connect {1,..,n-1}. Then tree only spans a part of it.
+ */
+template<class coord_type, class dist_type>
+bool prim_heap(TSP::OneTree &tree, const ModifiedWeights<coord_type, dist_type> &weights, TSP::size_type n,
+               HeldKarpWorkspace<dist_type> &ws, const std::vector<std::vector<NodeId> > *adjacency = nullptr) {
+    typedef typename HeldKarpWorkspace<dist_type>::HeapEntry Pair;
+    std::greater<Pair> heap_order;
+    std::vector<Pair> &pq = ws.heap;
+    pq.clear();
+
+    NodeId src = 1; // Start at the first node != 0
     // First, make all nodes unreachable
-    std::vector<double> key(n, ::std::numeric_limits<double>::max() / 2.);
+    std::vector<dist_type> &key = ws.key;
+    std::fill(key.begin(), key.end(), std::numeric_limits<dist_type>::max());
 
     // parent will give access to the second node in an edge for the MST
-    std::vector<int> parent(n, -1);
+    std::vector<NodeId> &parent = ws.heap_parent;
 
     // included vertices vector
-    std::vector<bool> MST_contained(n, false);
+    std::vector<char> &MST_contained = ws.contained;
+    std::fill(MST_contained.begin(), MST_contained.end(), false);
+    size_type num_contained = 0;
     //start with the source....
-    pq.push(std::make_pair(0, src));
+    pq.push_back(std::make_pair(0, src));
     key[src] = 0;
 
+    auto relax = [&](NodeId u, NodeId i) {
+        if (i != 0 && !MST_contained[i]) {
+            dist_type weight = weights(u, i);
+            if (key[i] > weight) {
+                // Updating key of i
+                key[i] = weight;
+                pq.push_back(std::make_pair(key[i], i));
+                std::push_heap(pq.begin(), pq.end(), heap_order);
+                parent[i] = u;
+            }
+        }
+    };
+
     while (!pq.empty()) {
-        TSP::NodeId u = pq.top().second;
-        pq.pop();
+        std::pop_heap(pq.begin(), pq.end(), heap_order);
+        TSP::NodeId u = pq.back().second;
+        pq.pop_back();
+        if (MST_contained[u]) // outdated entry
+            continue;
 
         MST_contained[u] = true;  // Include vertex in MST
+        num_contained++;
+        if (u != src)
+            tree.set_parent(u, parent[u]);
 
-        for (TSP::NodeId i = 1; i < n; i++) {
-            if (i != u) {
-                dist_type weight = mod_weights.at(to_EdgeId(u, i, n));
-                if (MST_contained[i] == false && key[i] > weight) {
-                    // Updating key of i
-                    key[i] = weight;
-                    pq.push(std::make_pair(key[i], static_cast<int>(i)));
-                    parent[i] = u;
-                }
-            }
+        if (adjacency) {
+            for (const auto &el : (*adjacency)[u])
+                relax(u, el);
+            for (const auto &el : weights.required_neighbors()[u].neighbors())
+                relax(u, el);
+        } else {
+            for (TSP::NodeId i = 1; i < n; i++)
+                relax(u, i);
         }
     }
-    //Done with MST computation, add them to our tree
-    for (TSP::NodeId k = 2; k < n; k++) {
-        tree.add_edge(k, static_cast<NodeId >(parent[k]));
-    }
+    return num_contained + 1 == n;
+}
 
-    //seek for smallest two edges incident to 0 ..
-    TSP::NodeId smallest = 1;
-    for (TSP::NodeId k = 2; k < n; k++) {
-        if (mod_weights.at(to_EdgeId(0, k, n)) < mod_weights.at(to_EdgeId(0, smallest, n))) {
+/**
+ * adds the two cheapest edges incident to node 0 to the tree
+ * @tparam coord_type
+ * @tparam dist_type
+ * @param tree
+ * @param weights modified weights
+ * @param n size of the instance
+ * @param neighbors if given, only the edges to these nodes (and the required ones) are considered, else all
+ * @return false, if one of the two edges is forbidden
+ */
+template<class coord_type, class dist_type>
+bool add_root_edges(TSP::OneTree &tree, const ModifiedWeights<coord_type, dist_type> &weights, TSP::size_type n,
+                    const std::vector<NodeId> *neighbors = nullptr) {
+    //seek for smallest two edges incident to 0, ties go to the first one seen
+    TSP::NodeId smallest = n, smallest1 = n;
+    dist_type smallest_weight = 0, smallest1_weight = 0;
+    auto consider = [&](NodeId k) {
+        if (k == smallest || k == smallest1)
+            return;
+        dist_type weight = weights(0, k);
+        if (smallest == n || weight < smallest_weight) {
+            smallest1 = smallest;
+            smallest1_weight = smallest_weight;
             smallest = k;
+            smallest_weight = weight;
+        } else if (smallest1 == n || weight < smallest1_weight) {
+            smallest1 = k;
+            smallest1_weight = weight;
         }
+    };
+    if (neighbors) {
+        for (const auto &el : *neighbors)
+            consider(el);
+        for (const auto &el : weights.required_neighbors()[0].neighbors())
+            consider(el);
+    } else {
+        for (TSP::NodeId k = 1; k < n; k++)
+            consider(k);
     }
+    if (smallest1 == n)
+        return false;
+    // ..add them
+    tree.set_root_neighbors(smallest, smallest1);
+    return smallest1_weight < ModifiedWeights<coord_type, dist_type>::forbidden_weight();
+}
 
-    TSP::NodeId smallest1 = 1;
-    if (smallest == 1) smallest1 = 2;
-    for (TSP::NodeId k = 2; k < n; k++) {
-        if (k != smallest) {
-            if (mod_weights.at(to_EdgeId(0, k, n)) < mod_weights.at(to_EdgeId(0, smallest1, n))) {
-                smallest1 = k;
-            }
-        }
+/**
+ * computes a minimum-1-tree for the given constraints
+ * @tparam coord_type
+ * @tparam dist_type
+ * @param tree space to save the optimal tree
+ * @param lambda
+ * @param tsp The TSP Instance
+ * @param status required and forbidden edges
+ * @param required_neighbors required edges as neighbor lists
+ * @param engine algorithm used for the MST part
+ */
+template<class coord_type, class dist_type>
+void compute_minimal_1_tree(TSP::OneTree &tree,
+                            const std::vector<double> &lambda,
+                            const TSP::Instance<coord_type, dist_type> &tsp,
+                            const EdgeStatus &status,
+                            const std::vector<Node> &required_neighbors,
+                            OneTreeEngine engine = OneTreeEngine::dense) {
+    TSP::size_type n = tsp.size();
+    ModifiedWeights<coord_type, dist_type> weights(tsp, lambda, status, required_neighbors);
+    HeldKarpWorkspace<dist_type> &ws = HeldKarpWorkspace<dist_type>::local(n);
+
+    // computing a MST on {2,..,n}
+    if (engine == OneTreeEngine::dense)
+        prim_dense(tree, weights, n, ws);
+    else
+        prim_heap(tree, weights, n, ws);
+    add_root_edges(tree, weights, n);
+}
+
+/**
+ * computes a minimum-1-tree for the constraints of a BranchingNode. Once edges are eliminated, see
+ * Instance::reduced_graph(), only the remaining ones and the required ones are considered.
+ * @tparam coord_type
+ * @tparam dist_type
+ * @param tree space to save the optimal tree
+ * @param lambda the multipliers of the modified weights, e.g. those of the BranchingNode
+ * @param tsp The TSP Instance
+ * @param constraints required and forbidden edges of the BranchingNode
+ * @return false, if the remaining edges which are not forbidden do not contain a 1-tree. Then no tour
+ * shorter than the best one respects the constraints and tree is garbage.
+ */
+template<class coord_type, class dist_type>
+bool compute_minimal_1_tree(TSP::OneTree &tree,
+                            const std::vector<double> &lambda,
+                            const TSP::Instance<coord_type, dist_type> &tsp,
+                            const Constraints &constraints) {
+    std::shared_ptr<const std::vector<std::vector<NodeId> > > graph = tsp.reduced_graph();
+    if (!graph) {
+        compute_minimal_1_tree(tree, lambda, tsp, constraints.status(), constraints.required_neighbors());
+        return true;
     }
-    // ..add them
-    tree.add_edge(0, smallest);
-    tree.add_edge(0, smallest1);
+    TSP::size_type n = tsp.size();
+    ModifiedWeights<coord_type, dist_type> weights(tsp, lambda, constraints.status(),
+                                                   constraints.required_neighbors());
+    return prim_dense(tree, weights, n, HeldKarpWorkspace<dist_type>::local(n), graph.get())
+        && add_root_edges(tree, weights, n, &(*graph)[0]);
+}
+
+/**
+ * computes a minimum-1-tree for the constraints of a BranchingNode on a sparse graph, i.e. the MST part only uses
+ * the given and the required edges. The result is not a minimum 1-tree of the complete graph, so its
+ * value is no lower bound by itself.
+ * @tparam coord_type
+ * @tparam dist_type
+ * @param tree space to save the tree
+ * @param lambda
+ * @param tsp The TSP Instance
+ * @param constraints required and forbidden edges of the BranchingNode
+ * @param adjacency neighbor lists of the sparse graph, e.g. the candidate graph of the instance
+ * @return false, if the sparse graph without forbidden edges is not connected. Then tree is garbage.
+ */
+template<class coord_type, class dist_type>
+bool compute_sparse_1_tree(TSP::OneTree &tree,
+                           const std::vector<double> &lambda,
+                           const TSP::Instance<coord_type, dist_type> &tsp,
+                           const Constraints &constraints,
+                           const std::vector<std::vector<NodeId> > &adjacency) {
+    TSP::size_type n = tsp.size();
+    ModifiedWeights<coord_type, dist_type> weights(tsp, lambda, constraints.status(),
+                                                   constraints.required_neighbors());
+    if (!prim_heap(tree, weights, n, HeldKarpWorkspace<dist_type>::local(n), &adjacency))
+        return false;
+    add_root_edges(tree, weights, n);
+    return true;
+}
+
+/**
+ * @return the value \f$ c(T) + \sum_i (deg_T(i) - 2) \lambda_i \f$ of a 1-tree T
+ */
+template<class coord_type, class dist_type>
+dist_type one_tree_value(const TSP::OneTree &tree,
+                         const std::vector<double> &lambda,
+                         const TSP::Instance<coord_type, dist_type> &tsp) {
+    dist_type sum = 0, sum2 = 0;
+    tree.for_each_edge([&](NodeId i, NodeId j) { sum += tsp.weight(i, j); });
+    for (size_t node = 0; node < tsp.size(); node++)
+        sum2 += (tree.degree(node) - 2.) * lambda[node];
+    return sum + sum2;
 }
 
 /**
@@ -124,100 +495,238 @@ void compute_minimal_1_tree(TSP::OneTree &tree,
  * @tparam coord_type
  * @tparam dist_type
  * @param tsp The TSP Instance
- * @param lambda lambda set by root BranchingNode (or where to set for not BranchingNode)
+ * @param lambda multipliers to start from, replaced by the best ones found
+ * @param state initial step size of a child's ascent, calibrated by the first child below the root
+ * and inherited from there on. Also receives the number of 1-trees computed
  * @param tree container for tree computation
- * @param bn current BranchingNode
+ * @param constraints required and forbidden edges of the current BranchingNode
  * @param root true, if we are in the root of our B'n'B tree
- * @return
+ * @param upper_bound length of the best known tour. Every value of a 1-tree on all edges is a lower
+ * bound, so we stop as soon as one reaches upper_bound: the node will be pruned anyway.
+ * @return the lower bound. Returns max() if the edges left by the elimination do not contain a 1-tree, see
+ * compute_minimal_1_tree(). If the instance has a candidate graph, the subgradient method of the root runs
+ * on it. Every pricing_interval iterations and for the best lambda at the end a 1-tree on all edges is
+ * computed (pricing): its edges are added to the sparse graph and the best of these values is the bound.
+ * The children do few iterations anyway and would gain little, so they use all edges.
  */
 template<class coord_type, class dist_type>
 dist_type Held_Karp(const TSP::Instance<coord_type, dist_type> &tsp,
                     std::vector<double> &lambda,
+                    AscentState &state,
                     TSP::OneTree &tree,
-                    const TSP::BranchingNode<coord_type, dist_type> &bn,
-                    bool root = false) {
+                    const Constraints &constraints,
+                    bool root = false,
+                    dist_type upper_bound = std::numeric_limits<dist_type>::max()) {
     // Initialization
     TSP::size_type n = tsp.size();
-    std::vector<dist_type> sol_vector;
-    std::vector<double> lambda_max(lambda.size(), 0), lambda_tmp(lambda);
-    TSP::OneTree tree_max(tree), tree_tmp(tree);
-    double t_0 = 0., del_0 = 0., deldel = 0.;
-    size_t max_el = 0;
+    HeldKarpWorkspace<dist_type> &ws = HeldKarpWorkspace<dist_type>::local(n);
+    TSP::OneTree &current = ws.tree, &previous = ws.previous;
+    std::vector<double> &lambda_tmp = ws.lambda, &lambda_max = ws.lambda_max;
+    lambda_tmp = lambda;
+    dist_type value_max = std::numeric_limits<dist_type>::lowest();
+    auto reaches_upper_bound = [&](dist_type value) {
+        return std::ceil((1. - EPS) * value) >= upper_bound;
+    };
+    double t_0 = 0.;
+    // the maximal number of iterations, the step policy usually stops earlier
     size_t N = std::ceil(n / 4.) + 5;
     if (root) {
         N = std::ceil(n * n / 50.) + n + 15;
     }
-    // First tree computation to obtain t_0, del_0 , deldel
-    compute_minimal_1_tree<coord_type, dist_type>(tree, lambda_tmp, tsp, bn);
+    // on the candidate graph if there is one, if it falls apart due to forbidden edges on all edges
+    bool sparse = root && tsp.has_candidate_graph();
+    std::vector<std::vector<NodeId> > candidates;
+    if (sparse)
+        candidates = tsp.candidates();
+    auto compute_tree = [&]() {
+        current.clear();
+        if (sparse && compute_sparse_1_tree<coord_type, dist_type>(current, lambda_tmp, tsp, constraints, candidates))
+            return true;
+        current.clear();
+        return compute_minimal_1_tree<coord_type, dist_type>(current, lambda_tmp, tsp, constraints);
+    };
+    // pricing: the sparse values are no lower bounds and lambda may run off if the candidate graph has
+    // no tour. So from time to time we take the 1-tree on all edges, add its edges and keep the best one
+    const size_t pricing_interval = 10;
+    dist_type priced_max = std::numeric_limits<dist_type>::lowest();
+    auto price = [&](const std::vector<double> &l) {
+        ws.full.clear();
+        compute_minimal_1_tree<coord_type, dist_type>(ws.full, l, tsp, constraints);
+        ws.full.for_each_edge([&](NodeId v, NodeId w) {
+            if (std::find(candidates[v].begin(), candidates[v].end(), w) == candidates[v].end()) {
+                candidates[v].push_back(w);
+                candidates[w].push_back(v);
+            }
+        });
+        dist_type value = one_tree_value(ws.full, l, tsp);
+        if (value > priced_max) {
+            priced_max = value;
+            ws.lambda_priced = l;
+            ws.tree_priced = ws.full;
+        }
+    };
+    // First tree computation to obtain t_0
+    if (!compute_tree())
+        return std::numeric_limits<dist_type>::max();
     if (root) {
         dist_type sum = 0;
-        for (const auto &el : tree.get_edges())
-            sum += tsp.weight(el);
+        current.for_each_edge([&](NodeId v, NodeId w) { sum += tsp.weight(v, w); });
         t_0 = sum / (2. * n);
+    } else if (state.step > 0.) { // the calibration of the first child below the root
+        t_0 = state.step;
     } else {
         t_0 = 0;
         for (TSP::NodeId i = 0; i < n; i++) {
             t_0 += fabs(lambda.at(i));
         }
         t_0 *= 1. / (2. * n);
+        state.step = t_0;
     }
+    state.iterations = 1;
 
-    deldel = t_0 / (N * N - N);
-    del_0 = 3. * t_0 / (2. * N);
+    // the children start from the multipliers of their parent and do few iterations anyway
+    StepPolicy<dist_type> policy(root ? tsp.step_rule() : StepRule::linear, t_0, N, upper_bound);
+    std::vector<double> &direction = ws.direction;
 
     for (size_t i = 0; i < N; i++) {
-        //Computing the sum we later on want to maximize over
-        dist_type sum = 0, sum2 = 0;
-        for (const auto &el : tree.get_edges())
-            sum += tsp.weight(el);
-        for (size_t node = 0; node < n; node++)
-            sum2 += (tree.get_node(node).degree() - 2.) * lambda_tmp[node];
-        sol_vector.push_back(sum + sum2); //we save all, not necessary, but nice for understanding
-
-        if (i == 0) { // the first iteration is slightly different..
-            tree_max = tree;
-            lambda_max = lambda_tmp;
+        // only the best value and its lambda and tree are kept
+        dist_type value = one_tree_value(current, lambda_tmp, tsp);
+        if (sparse && i % pricing_interval == 0)
+            price(lambda_tmp);
 
-            for (size_t j = 0; j < lambda_tmp.size(); j++) {
-                lambda_tmp[j] += t_0 * (tree.get_node(j).degree() - 2.);
-            }
-            t_0 = t_0 - del_0;
-            del_0 = del_0 - deldel;
-            tree_tmp = tree;
+        if (i == 0 || value_max < value) {
+            value_max = value;
+            lambda_max = lambda_tmp;
+            ws.tree_max = current;
         }
-
-        if (i > 0) { // ..then this one
-            if (sol_vector[max_el] < sol_vector[i]) {
-                lambda_max = lambda_tmp;
-                max_el = i;
-                tree_max = tree;
-            }
-            for (size_t j = 0; j < lambda_tmp.size(); j++) {
-                lambda_tmp[j] +=
-                    t_0 * (0.6 * (tree.get_node(j).degree() - 2.) + 0.4 * (tree_tmp.get_node(j).degree() - 2.));
-            }
-            t_0 = t_0 - del_0;
-            del_0 = del_0 - deldel;
-            tree_tmp = tree;
+        // the sparse values are no lower bounds, only the priced ones are
+        if (sparse ? reaches_upper_bound(priced_max) : reaches_upper_bound(value_max))
+            break;
+        double norm2 = 0.;
+        for (size_t j = 0; j < n; j++) {
+            if (i == 0) // the first iteration is slightly different..
+                direction[j] = current.degree(j) - 2.;
+            else // ..then this one
+                direction[j] = 0.6 * (current.degree(j) - 2.) + 0.4 * (previous.degree(j) - 2.);
+            norm2 += direction[j] * direction[j];
         }
-        tree = TSP::OneTree(n);
-        compute_minimal_1_tree<coord_type, dist_type>(tree, lambda_tmp, tsp, bn);
+        // a tour, no direction to improve along
+        if (norm2 == 0.)
+            break;
+        double t = policy.step(value, norm2);
+        if (policy.converged())
+            break;
+        for (size_t j = 0; j < n; j++)
+            lambda_tmp[j] += t * direction[j];
+        std::swap(current, previous);
+        state.iterations++;
+        if (!compute_tree())
+            return std::numeric_limits<dist_type>::max();
     }
-    if (root) { //Setting the holy lambda
-        lambda = lambda_max;
+    if (sparse) {
+        price(lambda_max);
+        lambda = ws.lambda_priced;
+        tree = ws.tree_priced;
+        return std::ceil((1. - EPS) * priced_max);
     }
-    tree = tree_max;
+    lambda = lambda_max; // the children continue from here
+    tree = ws.tree_max;
     // Multiplying by 1. - EPS whereas EPS is a Macro defined to 10e-7 since we do not want to
     // obtain a lower bound larger than the optimum solution. This could occur due to
     // floating point computations .
-    return std::ceil((1. - EPS) * (*std::max_element(sol_vector.begin(), sol_vector.end())));
+    return std::ceil((1. - EPS) * value_max);
+}
+
+/**
+ * creates the children of a BranchingNode whose tree is not 2-regular. We pick the first node gl_i
+ * of degree > 2 and two of its incident edges e1, e2 which are not required. Then the children are
+ * given by forbidding e1, requiring e1 and forbidding e2 and, if gl_i has no required edge yet,
+ * requiring e1 and e2.
+ * @tparam coord_type
+ * @tparam dist_type
+ * @param BNode BranchingNode to branch on
+ * @param tree its 1-tree, see BranchingNode::get_tree(). Used as scratch space for the children afterwards
+ * @param constraints its constraints, see BranchingNode::rebuild(). The decisions of every child are
+ * applied to them and taken back once the child is created, so they are unchanged in the end
+ * @param tsp The TSP Instance
+ * @param children container the children are appended to. With Bounding::eager they are bounded and
+ * those which are pruned while they are bounded are not appended, with Bounding::lazy they are unbounded.
+ * Children whose constraints are infeasible are never bounded nor appended.
+ * @param upper_bound length of the best known tour
+ * @param statistics counters the bounded and the infeasible children are added to
+ */
+template<class coord_type, class dist_type>
+void branch(const TSP::BranchingNode<coord_type, dist_type> &BNode,
+            TSP::OneTree &tree,
+            Constraints &constraints,
+            const TSP::Instance<coord_type, dist_type> &tsp,
+            std::vector<TSP::BranchingNode<coord_type, dist_type> > &children,
+            dist_type upper_bound,
+            SearchStatistics &statistics) {
+    typedef TSP::BranchingNode<coord_type, dist_type> BNode_type;
+
+    size_type gl_i = 0, choice1 = std::numeric_limits<size_type>::max(),
+        choice2 = std::numeric_limits<size_type>::max();
+    for (NodeId node = 1; node < tree.size(); node++) {
+        if (tree.degree(node) > 2) {
+            gl_i = node;
+            break;
+        }
+    }
+
+    assert(gl_i != 0);
+    size_t counter = 0;
+    for (const auto &el : tree.neighbors(gl_i)) {
+        if (!constraints.is_required(to_EdgeId(gl_i, el, tsp.size()))) {
+            assert(!constraints.is_forbidden(to_EdgeId(gl_i, el, tsp.size())));
+            if (counter == 0)
+                choice1 = el;
+            if (counter == 1)
+                choice2 = el;
+            counter++;
+            if (counter > 1)
+                break;
+        }
+    }
+    assert(choice1 < std::numeric_limits<NodeId>::max());
+    assert(choice2 < std::numeric_limits<NodeId>::max());
+    EdgeId e1 = to_EdgeId(gl_i, choice1, tsp.size()), e2 = to_EdgeId(gl_i, choice2, tsp.size());
+    auto append = [&](std::initializer_list<Decision> added) {
+        std::vector<Decision> decisions;
+        constraints.set_log(&decisions);
+        for (const auto &el : added) {
+            if (el.second == EdgeStatus::REQUIRED)
+                constraints.add_required(el.first);
+            else
+                constraints.add_forbidden(el.first);
+        }
+        constraints.set_log(nullptr);
+        if (constraints.infeasible()) {
+            constraints.undo(decisions);
+            statistics.infeasible++;
+            return;
+        }
+        BNode_type child(BNode, std::move(decisions));
+        if (tsp.bounding() == Bounding::eager) {
+            child.bound(tsp, constraints, tree, upper_bound);
+            statistics.add(child.get_ascent());
+        }
+        constraints.undo(child.get_decisions()->decisions);
+        if (!child.is_pruned())
+            children.push_back(std::move(child));
+    };
+    append({Decision(e1, EdgeStatus::FORBIDDEN)});
+    append({Decision(e1, EdgeStatus::REQUIRED), Decision(e2, EdgeStatus::FORBIDDEN)});
+
+    if (!constraints.required_neighbors().at(gl_i).degree())
+        append({Decision(e1, EdgeStatus::REQUIRED), Decision(e2, EdgeStatus::REQUIRED)});
 }
 
 // ---------------------------------------------------------------------------------
 // ---------------    TSP::Instance section ----------------------------------------
 // ---------------------------------------------------------------------------------
 template<class coord_type, class dist_type>
-Instance<coord_type, dist_type>::Instance(const std::string &filename) : _length(0){
+Instance<coord_type, dist_type>::Instance(const std::string &filename, DistanceMode mode) : _length(0){
     std::ifstream file(filename);
     if (!file.is_open())
         throw std::runtime_error("File " + filename + " could not be opened");
@@ -243,14 +752,14 @@ Instance<coord_type, dist_type>::Instance(const std::string &filename) : _length
     if (!scan)
         throw std::runtime_error("File not in right format");
 
-    std::vector<coord_type> x, y;
+    std::vector<coord_type> &x = _x, &y = _y;
     x.reserve(dimension), y.reserve(dimension);
     coord_type coord_x = std::numeric_limits<coord_type>::max(), coord_y = std::numeric_limits<coord_type>::max();
-    while (file.good()) {
-        getline(file, line);
+    while (getline(file, line)) {
         std::stringstream strstr;
         strstr << line;
-        strstr >> option;
+        if (!(strstr >> option)) // skip empty lines, e.g. the last one if there is no EOF
+            continue;
         if (option != "EOF") {
             try {
                 strstr >> coord_x >> coord_y;
@@ -262,81 +771,536 @@ Instance<coord_type, dist_type>::Instance(const std::string &filename) : _length
         } else break;
     }
     file.close();
-    for (size_t i = 0; i < dimension; i++)
-        for (size_t j = 0; j < dimension; j++)
-            this->_weights.push_back(
-                distance(x[i], y[i], x[j], y[j])
-            );
+    if (x.size() != dimension)
+        throw std::runtime_error("File " + filename + " has " + std::to_string(x.size()) + " nodes, but DIMENSION "
+                                     + std::to_string(dimension));
+    if (mode == DistanceMode::automatic)
+        mode = (dimension <= max_matrix_dimension) ? DistanceMode::matrix : DistanceMode::coordinates;
+    _mode = mode;
+    if (_mode == DistanceMode::matrix) {
+        this->_weights.reserve(dimension * (dimension - 1) / 2);
+        for (size_t i = 0; i < dimension; i++)
+            for (size_t j = i + 1; j < dimension; j++)
+                this->_weights.push_back(
+                    distance(x[i], y[i], x[j], y[j])
+                );
+    }
     _tour = std::vector<NodeId>(dimension);
+    _spatial_index = KdTree<coord_type>(x, y);
 }
 
 template<class coord_type, class dist_type>
-void Instance<coord_type, dist_type>::compute_optimal_tour() {
+void Instance<coord_type, dist_type>::weight_row(NodeId u, dist_type *row) const {
+    if (_mode == DistanceMode::matrix) {
+        // column u of the upper triangle, the step to the next row shrinks by one each time ..
+        EdgeId edge = u - 1;
+        for (NodeId i = 0; i < u; i++) {
+            row[i] = _weights[edge];
+            edge += dimension - i - 2;
+        }
+        row[u] = 0;
+        // .. and row u, which is contiguous
+        std::copy(_weights.begin() + row_offset(u, dimension),
+                  _weights.begin() + row_offset(u + 1, dimension), row + u + 1);
+    } else {
+        for (NodeId i = 0; i < dimension; i++)
+            row[i] = distance(_x[u], _y[u], _x[i], _y[i]);
+    }
+}
+
+template<class coord_type, class dist_type>
+void Instance<coord_type, dist_type>::build_candidate_graph(CandidateType type, size_type k) {
+    _candidates.assign(dimension, std::vector<NodeId>());
+    if (type == CandidateType::none || dimension < 3)
+        return;
+    k = std::min(k, dimension - 1);
+
+    for (NodeId i = 0; i < dimension; i++) {
+        std::vector<NodeId> chosen;
+        if (type == CandidateType::quadrant) {
+            // the k/4 nearest neighbors in each quadrant around i ..
+            size_type per_quadrant = std::max<size_type>(1, k / 4);
+            for (int quadrant = 0; quadrant < 4; quadrant++) {
+                auto in_quadrant = [&](NodeId j) {
+                    return quadrant == (_x[j] >= _x[i] ? 0 : 1) + (_y[j] >= _y[i] ? 0 : 2);
+                };
+                for (const auto &el : _spatial_index.nearest_if(i, per_quadrant, in_quadrant))
+                    chosen.push_back(el);
+            }
+            // .. filled up with the nearest ones
+            for (const auto &el : _spatial_index.nearest(i, k)) {
+                if (chosen.size() >= k)
+                    break;
+                if (std::find(chosen.begin(), chosen.end(), el) == chosen.end())
+                    chosen.push_back(el);
+            }
+        } else {
+            chosen = _spatial_index.nearest(i, k);
+        }
+        for (const auto &el : chosen) {
+            _candidates[i].push_back(el);
+            _candidates[el].push_back(i);
+        }
+    }
+    for (auto &el : _candidates) {
+        std::sort(el.begin(), el.end());
+        el.erase(std::unique(el.begin(), el.end()), el.end());
+    }
+}
+
+template<class coord_type, class dist_type>
+void Instance<coord_type, dist_type>::compute_optimal_tour(size_type num_threads) {
+    if (num_threads > 1)
+        search_parallel(num_threads);
+    else
+        search_serial();
+}
+
+template<class coord_type, class dist_type>
+void Instance<coord_type, dist_type>::search_serial() {
     typedef BranchingNode<coord_type, dist_type> BNode;
 
-    dist_type upperBound = std::numeric_limits<dist_type>::max();
-    std::priority_queue<BNode,
-                        std::vector<BNode>, std::greater<BNode> > Q;
-    Q.push(BranchingNode<coord_type, dist_type>(*this)); // Adding empty node to Q
+    dist_type upperBound = initial_tour();
+    SpillingQueue<BNode, dist_type> Q(_memory_limit);
+    // the constraints and the 1-tree of the node at hand
+    Constraints constraints(size());
+    OneTree tree(size());
+    _statistics = SearchStatistics();
+    if (_resume_file.empty()) {
+        BNode root(*this, constraints, tree, upperBound);
+        _root_lambda = root.get_lambda();
+        _statistics.add_root(root.get_ascent());
+        Q.push(std::move(root), root.get_HK()); // Adding empty node to Q
+    } else {
+        upperBound = resume(upperBound, [&](BNode &&el) { Q.push(std::move(el), el.get_HK()); });
+    }
+    compute_root_tree(constraints, tree);
+    upperBound = improve_tour(upperBound);
+    eliminate_edges(upperBound);
+    CheckpointWriter<BNode, dist_type> writer(_checkpoint_file, _checkpoint_interval);
 
+    std::vector<BNode> children;
+    std::vector<NodeId> order;
+    size_type bounded = 0;
     while (!Q.empty()) {
-        BNode current_BNode(Q.top());
-        Q.pop();
-        if (current_BNode.get_HK() >= upperBound)
+        if (writer.due()) {
+            auto checkpoint = make_checkpoint(upperBound);
+            Q.snapshot(checkpoint.nodes, checkpoint.spilled);
+            writer.start(std::move(checkpoint));
+        }
+        BNode current_BNode(Q.pop());
+        if (current_BNode.get_HK() >= upperBound) {
+            if (!current_BNode.is_bounded())
+                _statistics.unbounded++;
             continue;
-        else {
-            if (current_BNode.tworegular()) {
-                upperBound = current_BNode.get_HK();
-                std::cerr << "Upper Bound " << upperBound << std::endl;
-                _tour = current_BNode.get_tree().get_edges();
+        }
+        current_BNode.rebuild(constraints);
+        if (!current_BNode.is_bounded()) {
+            current_BNode.bound(*this, constraints, tree, upperBound);
+            _statistics.add(current_BNode.get_ascent());
+            if (current_BNode.is_pruned())
                 continue;
-            } else {
-                size_type gl_i = 0, choice1 = std::numeric_limits<size_type>::max(),
-                    choice2 = std::numeric_limits<size_type>::max();
-                for (NodeId node = 1; node < current_BNode.get_tree().get_nodes().size(); node++) {
-                    if (current_BNode.get_tree().get_node(node).degree() > 2) {
-                        gl_i = node;
-                        break;
-                    }
+            // its bound went up, maybe some other node is more promising now
+            if (!Q.empty() && current_BNode.get_HK() > Q.top_key()) {
+                Q.push(std::move(current_BNode), current_BNode.get_HK());
+                _statistics.requeued++;
+                continue;
+            }
+        } else if (!current_BNode.get_tree(*this, constraints, tree)) {
+            continue;
+        }
+        if (tree.is_tour()) {
+            // the tree may have been rebuilt on fewer edges than it was bounded on, so its length may
+            // exceed get_HK(). It is still a minimum 1-tree of the node, so no tour of it is shorter
+            dist_type length = tree_length(tree);
+            if (length < upperBound) {
+                upperBound = length;
+                std::cerr << "Upper Bound " << upperBound << std::endl;
+                _tour = tree.edges();
+                prune_open(Q, upperBound, _statistics);
+                eliminate_edges(upperBound);
+            }
+        } else {
+            if (repair_due(current_BNode, bounded)) {
+                _statistics.repairs++;
+                dist_type length = repair(tree, constraints, order);
+                if (length < upperBound) {
+                    upperBound = length;
+                    std::cerr << "Upper Bound " << upperBound << " (repaired)" << std::endl;
+                    _tour = tour_edges(order);
+                    _statistics.repaired++;
+                    prune_open(Q, upperBound, _statistics);
+                    eliminate_edges(upperBound);
+                    // the tour is one of this node
+                    if (current_BNode.get_HK() >= upperBound)
+                        continue;
                 }
+            }
+            children.clear();
+            branch(current_BNode, tree, constraints, *this, children, upperBound, _statistics);
+            for (auto &el : children)
+                Q.push(std::move(el), el.get_HK());
+            _statistics.max_open = std::max(_statistics.max_open, Q.size());
+        }
+    }
+    std::cerr << "Optimal Length " << upperBound << std::endl;
+    _statistics.spilled = Q.num_spilled();
+    print_statistics();
+    if (!_checkpoint_file.empty()) {
+        writer.wait();
+        make_checkpoint(upperBound).write(_checkpoint_file);
+    }
 
-                assert(gl_i != 0);
-                size_t counter = 0;
-                for (const auto &el : current_BNode.get_tree().get_node(gl_i).neighbors()) {
-                    if (!current_BNode.is_required(to_EdgeId(gl_i, el, size()))) {
-                        assert(!current_BNode.is_forbidden(to_EdgeId(gl_i, el, size())));
-                        if (counter == 0)
-                            choice1 = el;
-                        if (counter == 1)
-                            choice2 = el;
-                        counter++;
-                        if (counter > 1)
-                            break;
+    this->_length = upperBound;
+}
+
+template<class coord_type, class dist_type>
+void Instance<coord_type, dist_type>::search_parallel(size_type num_threads) {
+    typedef BranchingNode<coord_type, dist_type> BNode;
+
+    std::atomic<dist_type> upperBound(initial_tour());
+    // number of nodes which are either queued or currently branched on. The search is done, iff it is 0
+    std::atomic<size_type> open_nodes(0);
+    std::mutex tour_mutex;
+    std::exception_ptr error = nullptr;
+
+    WorkStealingQueues<BNode, dist_type> Q(num_threads, _memory_limit);
+    std::vector<SearchStatistics> statistics(num_threads);
+    if (_resume_file.empty()) {
+        Constraints root_constraints(size());
+        OneTree root_tree(size());
+        BNode root(*this, root_constraints, root_tree, upperBound.load());
+        _root_lambda = root.get_lambda();
+        statistics[0].add_root(root.get_ascent());
+        Q.push(0, std::move(root), root.get_HK()); // Adding empty node to the first worker
+        open_nodes.store(1);
+    } else {
+        upperBound.store(resume(upperBound.load(), [&](BNode &&el) {
+            Q.push(open_nodes.load() % num_threads, std::move(el), el.get_HK());
+            open_nodes++;
+        }));
+    }
+    {
+        Constraints root_constraints(size());
+        OneTree root_tree(size());
+        compute_root_tree(root_constraints, root_tree);
+        upperBound.store(improve_tour(upperBound.load()));
+        eliminate_edges(upperBound.load());
+    }
+
+    // A checkpoint needs all open nodes in the queues. The worker which finds it due requests it, every
+    // worker pauses at the top of its loop and the last one to pause (or to stop) takes the snapshot.
+    CheckpointWriter<BNode, dist_type> writer(_checkpoint_file, _checkpoint_interval);
+    std::mutex checkpoint_mutex;
+    std::condition_variable checkpoint_done;
+    std::atomic<bool> checkpoint_requested(false);
+    size_type paused = 0, stopped = 0, checkpoints = 0;
+    // with checkpoint_mutex held
+    auto take_checkpoint = [&]() {
+        auto checkpoint = make_checkpoint(upperBound.load());
+        Q.snapshot(checkpoint.nodes, checkpoint.spilled);
+        writer.start(std::move(checkpoint));
+        checkpoint_requested.store(false);
+        paused = 0;
+        checkpoints++;
+        checkpoint_done.notify_all();
+    };
+    auto pause = [&]() {
+        std::unique_lock<std::mutex> lock(checkpoint_mutex);
+        if (!checkpoint_requested.load())
+            return;
+        if (++paused + stopped == num_threads)
+            return take_checkpoint();
+        size_type taken = checkpoints;
+        checkpoint_done.wait(lock, [&]() { return checkpoints != taken; });
+    };
+
+    auto worker = [&](size_type id) {
+        try {
+            BNode current_BNode;
+            std::vector<BNode> children;
+            std::vector<NodeId> order;
+            size_type bounded = 0;
+            // the constraints and the 1-tree of the node at hand
+            Constraints constraints(size());
+            OneTree tree(size());
+            while (open_nodes.load() > 0) {
+                if (id == 0) {
+                    std::lock_guard<std::mutex> lock(checkpoint_mutex);
+                    if (!checkpoint_requested.load() && writer.due())
+                        checkpoint_requested.store(true);
+                }
+                if (checkpoint_requested.load())
+                    pause();
+                if (!Q.pop(id, current_BNode)) {
+                    std::this_thread::yield();
+                    continue;
+                }
+                if (current_BNode.get_HK() >= upperBound.load()) {
+                    if (!current_BNode.is_bounded())
+                        statistics[id].unbounded++;
+                    open_nodes--;
+                    continue;
+                }
+                current_BNode.rebuild(constraints);
+                if (!current_BNode.is_bounded()) {
+                    current_BNode.bound(*this, constraints, tree, upperBound.load());
+                    statistics[id].add(current_BNode.get_ascent());
+                    if (current_BNode.is_pruned()) {
+                        open_nodes--;
+                        continue;
                     }
+                    // its bound went up, maybe some other node is more promising now. It stays open
+                    if (Q.push_if_not_best(id, current_BNode, current_BNode.get_HK())) {
+                        statistics[id].requeued++;
+                        continue;
+                    }
+                } else if (!current_BNode.get_tree(*this, constraints, tree)) {
+                    open_nodes--;
+                    continue;
                 }
-                assert(choice1 < std::numeric_limits<NodeId>::max());
-                assert(choice2 < std::numeric_limits<NodeId>::max());
-                BNode q1(current_BNode, *this, to_EdgeId(gl_i, choice1, this->size())),
-                    q2(current_BNode,
-                       *this,
-                       to_EdgeId(gl_i, choice1, this->size()),
-                       to_EdgeId(gl_i, choice2, this->size()));
-                Q.push(q1);
-                Q.push(q2);
-
-                if (!current_BNode.get_required_neighbors().at(gl_i).degree()) {
-                    BNode q3(current_BNode, *this,
-                             to_EdgeId(gl_i, choice1, this->size()),
-                             to_EdgeId(gl_i, choice2, this->size()),
-                             true);
-                    Q.push(q3);
+                if (tree.is_tour()) {
+                    // its length, not get_HK(), see search_serial()
+                    dist_type length = tree_length(tree);
+                    std::lock_guard<std::mutex> lock(tour_mutex);
+                    if (length < upperBound.load()) {
+                        upperBound.store(length);
+                        std::cerr << "Upper Bound " << length << std::endl;
+                        _tour = tree.edges();
+                        open_nodes -= prune_open(Q, upperBound.load(), statistics[id]);
+                        eliminate_edges(upperBound.load());
+                    }
+                } else {
+                    if (repair_due(current_BNode, bounded)) {
+                        statistics[id].repairs++;
+                        dist_type length = repair(tree, constraints, order);
+                        std::lock_guard<std::mutex> lock(tour_mutex);
+                        if (length < upperBound.load()) {
+                            upperBound.store(length);
+                            std::cerr << "Upper Bound " << length << " (repaired)" << std::endl;
+                            _tour = tour_edges(order);
+                            statistics[id].repaired++;
+                            open_nodes -= prune_open(Q, length, statistics[id]);
+                            eliminate_edges(length);
+                        }
+                    }
+                    // the repaired tour may be one of this node
+                    if (current_BNode.get_HK() >= upperBound.load()) {
+                        open_nodes--;
+                        continue;
+                    }
+                    children.clear();
+                    branch(current_BNode, tree, constraints, *this, children, upperBound.load(), statistics[id]);
+                    // children are counted before their parent is done, so open_nodes only hits 0 at the end
+                    for (auto &el : children) {
+                        if (el.get_HK() < upperBound.load()) {
+                            open_nodes++;
+                            Q.push(id, std::move(el), el.get_HK());
+                        }
+                    }
+                    statistics[id].max_open = std::max(statistics[id].max_open, open_nodes.load());
                 }
+                open_nodes--;
             }
         }
+        catch (...) {
+            std::lock_guard<std::mutex> lock(tour_mutex);
+            if (!error)
+                error = std::current_exception();
+            open_nodes.store(0); // let the others stop as well
+        }
+        std::lock_guard<std::mutex> lock(checkpoint_mutex);
+        stopped++;
+        if (checkpoint_requested.load() && paused + stopped == num_threads)
+            take_checkpoint();
+    };
+
+    std::vector<std::thread> workers;
+    for (size_type id = 0; id < num_threads; id++)
+        workers.emplace_back(worker, id);
+    for (auto &el : workers)
+        el.join();
+    if (error)
+        std::rethrow_exception(error);
+
+    std::cerr << "Optimal Length " << upperBound.load() << std::endl;
+    _statistics = SearchStatistics();
+    for (const auto &el : statistics)
+        _statistics += el;
+    _statistics.spilled = Q.num_spilled();
+    print_statistics();
+    if (!_checkpoint_file.empty()) {
+        writer.wait();
+        make_checkpoint(upperBound.load()).write(_checkpoint_file);
     }
-    std::cerr << "Optimal Length " << upperBound << std::endl;
 
-    this->_length = upperBound;
+    this->_length = upperBound.load();
+}
+
+template<class coord_type, class dist_type>
+Checkpoint<BranchingNode<coord_type, dist_type>, dist_type>
+Instance<coord_type, dist_type>::make_checkpoint(dist_type upper_bound) const {
+    Checkpoint<BranchingNode<coord_type, dist_type>, dist_type> checkpoint;
+    checkpoint.dimension = dimension;
+    checkpoint.upper_bound = upper_bound;
+    if (upper_bound < std::numeric_limits<dist_type>::max())
+        checkpoint.tour = _tour;
+    checkpoint.root_lambda = _root_lambda;
+    return checkpoint;
+}
+
+template<class coord_type, class dist_type>
+template<class Function>
+dist_type Instance<coord_type, dist_type>::resume(dist_type upper_bound, Function on_node) {
+    auto checkpoint = Checkpoint<BranchingNode<coord_type, dist_type>, dist_type>::read(_resume_file, dimension,
+                                                                                        on_node);
+    _root_lambda = checkpoint.root_lambda;
+    std::cerr << "Resumed from " << _resume_file << " with upper bound " << checkpoint.upper_bound << std::endl;
+    if (checkpoint.upper_bound >= upper_bound || checkpoint.tour.size() != dimension)
+        return upper_bound;
+    _tour = checkpoint.tour;
+    return checkpoint.upper_bound;
+}
+
+template<class coord_type, class dist_type>
+dist_type Instance<coord_type, dist_type>::initial_tour() {
+    if (dimension < 3)
+        return std::numeric_limits<dist_type>::max();
+    const size_type num_neighbors = 10;
+    _tour_neighbors = nearest_neighbor_lists(*this, num_neighbors);
+    if (!_heuristic)
+        return std::numeric_limits<dist_type>::max();
+    std::vector<NodeId> order = greedy_tour(*this, _tour_neighbors);
+    dist_type greedy_length = tour_length(*this, order);
+    dist_type length = LocalSearch<coord_type, dist_type>(*this, _tour_neighbors).improve(order);
+    _tour = tour_edges(order);
+    std::cerr << "Initial Upper Bound " << length << " (greedy " << greedy_length << ")" << std::endl;
+    return length;
+}
+
+template<class coord_type, class dist_type>
+void Instance<coord_type, dist_type>::compute_root_tree(Constraints &constraints, OneTree &tree) {
+    std::atomic_store(&_reduced_graph, std::shared_ptr<const std::vector<std::vector<NodeId> > >());
+    _eliminated = 0.;
+    _root_tree = OneTree(0);
+    if (dimension < 3 || _root_lambda.size() != dimension)
+        return;
+    constraints.reset();
+    tree.clear();
+    compute_minimal_1_tree(tree, _root_lambda, *this, constraints);
+    _root_tree = tree;
+}
+
+template<class coord_type, class dist_type>
+dist_type Instance<coord_type, dist_type>::improve_tour(dist_type upper_bound) {
+    if (!_heuristic || upper_bound == std::numeric_limits<dist_type>::max() || _root_tree.size() != dimension)
+        return upper_bound;
+    const size_type num_candidates = 5, depth = 10, kicks = 3 * dimension;
+    _tour_neighbors = alpha_nearness_lists(*this, _root_tree, _root_lambda, num_candidates);
+    std::vector<NodeId> order = tour_order(_tour, dimension);
+    dist_type length = LocalSearch<coord_type, dist_type>(*this, _tour_neighbors, depth).improve(order, kicks);
+    if (length >= upper_bound)
+        return upper_bound;
+    _tour = tour_edges(order);
+    std::cerr << "Upper Bound " << length << " (Lin-Kernighan)" << std::endl;
+    return length;
+}
+
+template<class coord_type, class dist_type>
+void Instance<coord_type, dist_type>::eliminate_edges(dist_type upper_bound) {
+    if (upper_bound == std::numeric_limits<dist_type>::max() || _root_tree.size() != dimension)
+        return;
+    const size_type n = dimension, num_edges = n * (n - 1) / 2;
+    // on few edges, prim_dense saves computing the rows of modified weights, but still scans all keys
+    const size_type max_sparse_edges = num_edges / sparse_graph_factor;
+    const dist_type value = one_tree_value(_root_tree, _root_lambda, *this);
+    auto graph = std::make_shared<std::vector<std::vector<NodeId> > >(n);
+    size_type remaining = 0;
+    alpha_nearness(*this, _root_tree, _root_lambda, [&](NodeId i, const std::vector<double> &alpha,
+                                                        const std::vector<dist_type> &) {
+        for (NodeId j = i + 1; j < n; j++) {
+            // the same rounding as the bounds of Held_Karp
+            if (std::ceil((1. - EPS) * (value + alpha[j])) >= upper_bound)
+                continue;
+            if (++remaining <= max_sparse_edges) {
+                (*graph)[i].push_back(j);
+                (*graph)[j].push_back(i);
+            }
+        }
+    });
+    // prim_dense still uses every edge while the graph is too dense to be installed
+    if (remaining > max_sparse_edges)
+        return;
+    std::atomic_store(&_reduced_graph, std::shared_ptr<const std::vector<std::vector<NodeId> > >(graph));
+    _eliminated = 1. - double(remaining) / num_edges;
+    std::cerr << "Eliminated " << 100. * _eliminated << "% of the edges" << std::endl;
+}
+
+template<class coord_type, class dist_type>
+dist_type Instance<coord_type, dist_type>::tree_length(const OneTree &tree) const {
+    dist_type length = 0;
+    tree.for_each_edge([&](NodeId i, NodeId j) { length += weight(i, j); });
+    return length;
+}
+
+template<class coord_type, class dist_type>
+bool Instance<coord_type, dist_type>::repair_due(const BranchingNode<coord_type, dist_type> &node,
+                                                 size_type &count) const {
+    if (_repair_interval == 0 || _tour_neighbors.empty())
+        return false;
+    return ++count % _repair_interval == 0 || node.depth() <= _repair_depth;
+}
+
+template<class coord_type, class dist_type>
+template<class Queue>
+size_type Instance<coord_type, dist_type>::prune_open(Queue &Q, dist_type upper_bound,
+                                                      SearchStatistics &statistics) const {
+    typedef BranchingNode<coord_type, dist_type> BNode;
+    size_type dropped;
+    if (_bounding == Bounding::lazy) {
+        dropped = Q.prune(upper_bound, [&](const BNode &el) {
+            if (!el.is_bounded())
+                statistics.unbounded++;
+        });
+    } else {
+        dropped = Q.prune(upper_bound);
+    }
+    statistics.dropped += dropped;
+    return dropped;
+}
+
+template<class coord_type, class dist_type>
+dist_type Instance<coord_type, dist_type>::repair(const OneTree &tree, const Constraints &constraints,
+                                                  std::vector<NodeId> &order) const {
+    std::vector<NodeId> patched;
+    if (!repair_tour(*this, tree, constraints, order, patched))
+        return std::numeric_limits<dist_type>::max();
+    LocalSearch<coord_type, dist_type> local_search(*this, _tour_neighbors);
+    local_search.set_constraints(&constraints);
+    return local_search.polish(order, patched);
+}
+
+template<class coord_type, class dist_type>
+void Instance<coord_type, dist_type>::print_statistics() const {
+    std::cerr << "Bounded " << _statistics.nodes << " nodes with " << _statistics.one_trees << " 1-trees";
+    if (_statistics.nodes > 1)
+        std::cerr << " (root " << _statistics.root_one_trees << ", "
+                  << double(_statistics.one_trees - _statistics.root_one_trees) / (_statistics.nodes - 1)
+                  << " per child)";
+    if (_bounding == Bounding::lazy)
+        std::cerr << ", discarded " << _statistics.unbounded << " unbounded, requeued " << _statistics.requeued;
+    std::cerr << ", at most " << _statistics.max_open << " open nodes, dropped " << _statistics.dropped
+              << " at once";
+    if (_memory_limit > 0)
+        std::cerr << ", spilled " << _statistics.spilled << " to disk";
+    if (_statistics.repairs > 0)
+        std::cerr << ", repaired " << _statistics.repairs << " 1-trees, " << _statistics.repaired
+                  << " of them improved the upper bound";
+    if (_statistics.infeasible > 0)
+        std::cerr << ", discarded " << _statistics.infeasible << " infeasible children";
+    if (_eliminated > 0.)
+        std::cerr << ", eliminated " << 100. * _eliminated << "% of the edges";
+    std::cerr << std::endl;
 }
 
 template<class coord_type, class dist_type>
@@ -388,89 +1352,6 @@ bool BranchingNode<coord_type, dist_type>::operator>(const BranchingNode <coord_
     return this->get_HK() > rhs.get_HK();
 }
 
-template<class coord_type, class dist_type>
-void BranchingNode<coord_type, dist_type>::forbid(NodeId idx, EdgeId e1, EdgeId e2) {
-    for (NodeId k = 0; k < size; k++) {
-        if (idx != k) {
-            EdgeId edge = to_EdgeId(idx, k, size);
-            if (edge != e1 && edge != e2) {
-                add_forbidden(edge);
-            }
-        }
-    }
-}
-
-template<class coord_type, class dist_type>
-void BranchingNode<coord_type, dist_type>::admit(NodeId idx) {
-    for (NodeId k = 0; k < size; k++) {
-        if (idx != k) {
-            EdgeId edge = to_EdgeId(idx, k, size);
-            if (!is_forbidden(edge))
-                add_required(edge);
-        }
-    }
-}
-
-template<class coord_type, class dist_type>
-bool BranchingNode<coord_type, dist_type>::push_required(EdgeId e) {
-    if (is_required(e))
-        return false;
-    assert(!is_forbidden(e));
-    NodeId i = 0, j = 0;
-    to_NodeId(e, i, j, size);
-    required.push_back(e);
-    required_neighbors.at(i).add_neighbor(j);
-    required.push_back(reverse_edge(e, size));
-    required_neighbors.at(j).add_neighbor(i);
-    return true;
-}
-
-template<class coord_type, class dist_type>
-void BranchingNode<coord_type, dist_type>::add_required(EdgeId e) {
-    if (!push_required(e))
-        return;
-    NodeId i = 0, j = 0;
-    to_NodeId(e, i, j, size);
-
-    if (required_neighbors.at(i).degree() == 2)
-        forbid(i, to_EdgeId(i, required_neighbors.at(i).neighbors().at(0), size),
-               to_EdgeId(i, required_neighbors.at(i).neighbors().at(1), size));
-    if (required_neighbors.at(j).degree() == 2)
-        forbid(j, to_EdgeId(j, required_neighbors.at(j).neighbors().at(0), size),
-               to_EdgeId(j, required_neighbors.at(j).neighbors().at(1), size));
-}
-
-template<class coord_type, class dist_type>
-bool BranchingNode<coord_type, dist_type>::push_forbidden(EdgeId e) {
-    if (is_forbidden(e))
-        return false;
-    assert(!is_required(e));
-    NodeId i = 0, j = 0;
-    to_NodeId(e, i, j, size);
-    forbidden.push_back(e);
-    forbidden_neighbors[i].add_neighbor(j);
-    forbidden.push_back(reverse_edge(e, size));
-    forbidden_neighbors[j].add_neighbor(i);
-    return true;
-}
-
-template<class coord_type, class dist_type>
-void BranchingNode<coord_type, dist_type>::add_forbidden(EdgeId e) {
-    // hier pushen wir die edges entsprechend
-    if (!push_forbidden(e))
-        return;
-    NodeId i = 0, j = 0;
-    to_NodeId(e, i, j, size);
-
-    if (forbidden_neighbors.at(i).degree() == size - 3) {
-        admit(i);
-    }
-    if (forbidden_neighbors.at(j).degree() == size - 3) {
-        admit(j);
-    }
-
-}
-
 // end class BranchingNone section
 
 } //end namespace TSP
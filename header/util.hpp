@@ -14,6 +14,8 @@
 #include <vector>
 #include <algorithm>
 #include <string>
+#include <cmath>
+#include <stdexcept>
 
 
 
@@ -24,6 +26,22 @@ using size_type = std::size_t;
 using NodeId = size_type;
 using EdgeId = size_type;
 
+/*
+ * Edges are undirected and numbered along the rows of the upper triangle of the adjacency matrix, i.e.
+ * (0,1), (0,2), ..., (0,N-1), (1,2), ..., (N-2,N-1). Thus, there are N(N-1)/2 EdgeIds and the edges
+ * of a row i to all j > i are contiguous.
+ */
+
+/**
+ * Compute the first EdgeId of row i, i.e. the id of the edge (i, i+1)
+ * @param i Node
+ * @param N Number of nodes in the underlying graph/instance
+ * @return \f$ i \cdot N - i(i+1)/2 \f$
+ */
+inline EdgeId row_offset(NodeId i, size_type N) {
+    return i * N - i * (i + 1) / 2;
+}
+
 /**
  * Compute the EdgeId from two NodeIds
  * @param i first Node
@@ -36,19 +54,47 @@ EdgeId to_EdgeId(NodeId i, NodeId j, size_type N) {
         throw std::runtime_error("Loops are not contained in this instance");
     if (i > j)
         std::swap(i, j);
-    return (i) * (N) + j;
+    return row_offset(i, N) + (j - i - 1);
 }
 
 /**
  * Compute the NodeIds corresponding to a given edge
  * @param e EdgeId we want we want to extract NodeIds from
- * @param i placeholder for first NodeId
+ * @param i placeholder for first NodeId, the smaller one
  * @param j placeholder for second NodeId
  * @param N Number of nodes in the underlying graph/instance
  */
 void to_NodeId(EdgeId e, NodeId &i, NodeId &j, size_type N) {
-    j = e % (N);
-    i = (e - j) / (N);
+    // invert row_offset, the floating point guess is off by at most one
+    double b = 2. * N - 1.;
+    i = static_cast<NodeId>((b - std::sqrt(std::max(0., b * b - 8. * e))) / 2.);
+    while (i > 0 && row_offset(i, N) > e)
+        i--;
+    while (i + 1 < N && row_offset(i + 1, N) <= e)
+        i++;
+    j = e - row_offset(i, N) + i + 1;
+}
+
+/**
+ * Writes the bytes of a trivially copyable value, e.g. to a spill file. The format is that of the
+ * machine, it is meant to be read by the same binary only.
+ * @param out
+ * @param value
+ */
+template<class T>
+void write_binary(std::ostream &out, const T &value) {
+    out.write(reinterpret_cast<const char *>(&value), sizeof(T));
+}
+
+/**
+ * Reads a value written by write_binary
+ * @param in
+ * @param value placeholder for the value
+ */
+template<class T>
+void read_binary(std::istream &in, T &value) {
+    if (!in.read(reinterpret_cast<char *>(&value), sizeof(T)))
+        throw std::runtime_error("Unexpected end of binary data");
 }
 
 /**
@@ -0,0 +1,149 @@
+/**
+ * @file work_stealing.hpp
+ *
+ * @brief Per-worker best-first queues for the parallel branch and bound. Every worker pushes the
+ * children it creates into its own queue and pops from there; only if its queue runs dry it steals
+ * the best element of another worker's queue.
+ */
+#ifndef BRANCHANDBOUNDTSP_WORK_STEALING_HPP
+#define BRANCHANDBOUNDTSP_WORK_STEALING_HPP
+
+#include <cstdlib>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+#include "spill.hpp"
+
+namespace TSP {
+
+/**
+ * @class WorkStealingQueues
+ * One locked SpillingQueue per worker. Locks are only contended if somebody is stealing. The elements are
+ * moved in and out, never copied.
+ * @tparam T element type, e.g. a BranchingNode
+ * @tparam key_type type of the keys the elements are ordered by, smallest first
+ */
+template<class T, class key_type>
+class WorkStealingQueues {
+ public:
+  /**
+   * Creates empty queues
+   * @param num_workers number of workers, each of them gets its own queue
+   * @param memory_limit bytes the elements in memory may take, split evenly among the queues. 0 for no limit
+   */
+  WorkStealingQueues(size_t num_workers, size_t memory_limit = 0) : _locals(num_workers) {
+      for (auto &el : _locals)
+          el.reset(new Local(memory_limit / num_workers));
+  }
+
+  /**
+   * pushes an element to the queue of @p worker
+   * @param worker id of the pushing worker
+   * @param el element, moved into the queue
+   * @param key
+   */
+  void push(size_t worker, T &&el, key_type key) {
+      Local &local = *_locals.at(worker);
+      std::lock_guard<std::mutex> lock(local.mutex);
+      local.queue.push(std::move(el), key);
+  }
+
+  /**
+   * pushes an element to the queue of @p worker, unless it is at least as good as the best one there
+   * @param worker id of the pushing worker
+   * @param el element, only moved from if it is pushed
+   * @param key
+   * @return true, if el was pushed
+   */
+  bool push_if_not_best(size_t worker, T &el, key_type key) {
+      Local &local = *_locals.at(worker);
+      std::lock_guard<std::mutex> lock(local.mutex);
+      if (local.queue.empty() || !(key > local.queue.top_key()))
+          return false;
+      local.queue.push(std::move(el), key);
+      return true;
+  }
+
+  /**
+   * drops the elements with a key >= upper_bound from all queues
+   * @return number of dropped elements
+   */
+  size_t prune(key_type upper_bound) {
+      size_t dropped = 0;
+      for (auto &el : _locals) {
+          std::lock_guard<std::mutex> lock(el->mutex);
+          dropped += el->queue.prune(upper_bound);
+      }
+      return dropped;
+  }
+
+  /**
+   * as above, but calls on_drop(el) for every dropped element el, see SpillingQueue::prune()
+   */
+  template<class Function>
+  size_t prune(key_type upper_bound, Function on_drop) {
+      size_t dropped = 0;
+      for (auto &el : _locals) {
+          std::lock_guard<std::mutex> lock(el->mutex);
+          dropped += el->queue.prune(upper_bound, on_drop);
+      }
+      return dropped;
+  }
+
+  /**
+   * @return number of elements written to disk so far
+   */
+  size_t num_spilled() const {
+      size_t spilled = 0;
+      for (const auto &el : _locals) {
+          std::lock_guard<std::mutex> lock(el->mutex);
+          spilled += el->queue.num_spilled();
+      }
+      return spilled;
+  }
+
+  /**
+   * takes a snapshot of all queues, see SpillingQueue::snapshot. The caller has to make sure that
+   * nobody pushes or pops in the meantime, if it is to be consistent.
+   */
+  void snapshot(std::vector<T> &elements, std::vector<SpilledRecords> &spilled) {
+      for (auto &el : _locals) {
+          std::lock_guard<std::mutex> lock(el->mutex);
+          el->queue.snapshot(elements, spilled);
+      }
+  }
+
+  /**
+   * pops the best element of the own queue, if there is none, it tries to steal the best element of
+   * the other queues, starting at the next worker
+   * @param worker id of the popping worker
+   * @param el placeholder the popped element is moved to
+   * @return false, if all queues were empty
+   */
+  bool pop(size_t worker, T &el) {
+      for (size_t k = 0; k < _locals.size(); k++) {
+          Local &local = *_locals[(worker + k) % _locals.size()];
+          std::lock_guard<std::mutex> lock(local.mutex);
+          if (!local.queue.empty()) {
+              el = local.queue.pop();
+              return true;
+          }
+      }
+      return false;
+  }
+
+ private:
+  struct Local {
+      explicit Local(size_t memory_limit) : queue(memory_limit) {}
+
+      mutable std::mutex mutex;
+      SpillingQueue<T, key_type> queue;
+  };
+  // std::mutex is neither copyable nor movable, hence the indirection
+  std::vector<std::unique_ptr<Local> > _locals;
+};
+
+}
+
+#endif //BRANCHANDBOUNDTSP_WORK_STEALING_HPP
@@ -9,6 +9,10 @@
  */
 #include "../header/graph.hpp"
 
+#include <algorithm>
+#include <cassert>
+#include <iterator>
+
 
 namespace TSP {
 /////////////////////////////////////////////
@@ -19,5 +23,11 @@ namespace TSP {
         _neighbors.push_back(id);
     }
 
+    void Node::remove_neighbor(NodeId const id) {
+        auto it = std::find(_neighbors.rbegin(), _neighbors.rend(), id);
+        assert(it != _neighbors.rend());
+        _neighbors.erase(std::next(it).base());
+    }
+
 
 } // namespace TSP
@@ -10,32 +10,172 @@
 #include <iostream>
 #include <cstring>
 #include <ctime>
+#include <chrono>
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
 #include "../header/tsp.hpp"
 
+/**
+ * parses a non-negative integer option value
+ * @param text the value as given on the command line
+ * @param value placeholder for the number
+ * @return true, if text is a number as a whole
+ */
+bool parse_number(const char *text, TSP::size_type &value) {
+    if (*text < '0' || *text > '9')
+        return false;
+    char *end = nullptr;
+    errno = 0;
+    unsigned long long number = std::strtoull(text, &end, 10);
+    if (errno != 0 || *end != '\0')
+        return false;
+    value = number;
+    return true;
+}
+
+/**
+ * parses a non-negative decimal option value
+ * @param text the value as given on the command line
+ * @param value placeholder for the number
+ * @return true, if text is a number as a whole
+ */
+bool parse_number(const char *text, double &value) {
+    if ((*text < '0' || *text > '9') && *text != '.')
+        return false;
+    char *end = nullptr;
+    errno = 0;
+    double number = std::strtod(text, &end);
+    if (errno != 0 || *end != '\0')
+        return false;
+    value = number;
+    return true;
+}
+
 int main(int argc, char* argv[]) {
     if (argc < 3) {
         std::cerr << "No parameters were given. Please give an --instance ./instance.tsp as an program argument" << std::endl;
         return EXIT_FAILURE;
     }
     if (strcmp(argv[1], "--instance") != 0) {
-        std::cerr << "First argument should be an instance of TSP. Execute like ./program --instance ./dir_to_instance.tsp [--solution ./dir_to_output.opt.tour]";
+        std::cerr << "First argument should be an instance of TSP. Execute like ./program --instance ./dir_to_instance.tsp [--solution ./dir_to_output.opt.tour] [--threads N] [--distances matrix|coordinates|auto] [--candidates none|nearest|quadrant] [--num-candidates K] [--step linear|polyak|auto] [--bounding eager|lazy] [--memory-limit MB] [--checkpoint ./file.ckpt] [--checkpoint-interval SECONDS] [--resume ./file.ckpt] [--heuristic on|off] [--repair INTERVAL] [--repair-depth DEPTH]";
         return EXIT_FAILURE;
     }
     std::string file = argv[2];
+    std::string solution = "";
+    TSP::size_type num_threads = 1;
+    TSP::DistanceMode distances = TSP::DistanceMode::automatic;
+    TSP::CandidateType candidates = TSP::CandidateType::none;
+    TSP::size_type num_candidates = 10;
+    TSP::StepRule step_rule = TSP::StepRule::automatic;
+    TSP::Bounding bounding = TSP::Bounding::eager;
+    TSP::size_type memory_limit = 0;
+    std::string checkpoint = "", resume = "";
+    double checkpoint_interval = 600.;
+    bool heuristic = true;
+    TSP::size_type repair_interval = 10, repair_depth = 5;
+    for (int arg = 3; arg < argc; arg += 2) {
+        if (arg + 1 == argc) {
+            std::cerr << "Missing value of argument " << argv[arg] << std::endl;
+            return EXIT_FAILURE;
+        }
+        // the value of a numeric argument, checked below
+        TSP::size_type number = 0;
+        bool numeric = true;
+        if (strcmp(argv[arg], "--solution") == 0) {
+            solution = argv[arg + 1];
+        } else if (strcmp(argv[arg], "--threads") == 0) {
+            numeric = parse_number(argv[arg + 1], number);
+            num_threads = std::max<TSP::size_type>(1, number);
+        } else if (strcmp(argv[arg], "--distances") == 0) {
+            if (strcmp(argv[arg + 1], "matrix") == 0)
+                distances = TSP::DistanceMode::matrix;
+            else if (strcmp(argv[arg + 1], "coordinates") == 0)
+                distances = TSP::DistanceMode::coordinates;
+            else if (strcmp(argv[arg + 1], "auto") != 0) {
+                std::cerr << "Unknown distance mode " << argv[arg + 1] << std::endl;
+                return EXIT_FAILURE;
+            }
+        } else if (strcmp(argv[arg], "--candidates") == 0) {
+            if (strcmp(argv[arg + 1], "nearest") == 0)
+                candidates = TSP::CandidateType::nearest;
+            else if (strcmp(argv[arg + 1], "quadrant") == 0)
+                candidates = TSP::CandidateType::quadrant;
+            else if (strcmp(argv[arg + 1], "none") != 0) {
+                std::cerr << "Unknown candidate graph " << argv[arg + 1] << std::endl;
+                return EXIT_FAILURE;
+            }
+        } else if (strcmp(argv[arg], "--num-candidates") == 0) {
+            numeric = parse_number(argv[arg + 1], number);
+            num_candidates = std::max<TSP::size_type>(1, number);
+        } else if (strcmp(argv[arg], "--step") == 0) {
+            if (strcmp(argv[arg + 1], "linear") == 0)
+                step_rule = TSP::StepRule::linear;
+            else if (strcmp(argv[arg + 1], "polyak") == 0)
+                step_rule = TSP::StepRule::polyak;
+            else if (strcmp(argv[arg + 1], "auto") != 0) {
+                std::cerr << "Unknown step rule " << argv[arg + 1] << std::endl;
+                return EXIT_FAILURE;
+            }
+        } else if (strcmp(argv[arg], "--bounding") == 0) {
+            if (strcmp(argv[arg + 1], "lazy") == 0)
+                bounding = TSP::Bounding::lazy;
+            else if (strcmp(argv[arg + 1], "eager") != 0) {
+                std::cerr << "Unknown bounding " << argv[arg + 1] << std::endl;
+                return EXIT_FAILURE;
+            }
+        } else if (strcmp(argv[arg], "--memory-limit") == 0) {
+            numeric = parse_number(argv[arg + 1], memory_limit);
+        } else if (strcmp(argv[arg], "--checkpoint") == 0) {
+            checkpoint = argv[arg + 1];
+        } else if (strcmp(argv[arg], "--checkpoint-interval") == 0) {
+            numeric = parse_number(argv[arg + 1], checkpoint_interval);
+        } else if (strcmp(argv[arg], "--resume") == 0) {
+            resume = argv[arg + 1];
+        } else if (strcmp(argv[arg], "--heuristic") == 0) {
+            if (strcmp(argv[arg + 1], "off") == 0)
+                heuristic = false;
+            else if (strcmp(argv[arg + 1], "on") != 0) {
+                std::cerr << "Unknown heuristic setting " << argv[arg + 1] << std::endl;
+                return EXIT_FAILURE;
+            }
+        } else if (strcmp(argv[arg], "--repair") == 0) {
+            numeric = parse_number(argv[arg + 1], repair_interval);
+        } else if (strcmp(argv[arg], "--repair-depth") == 0) {
+            numeric = parse_number(argv[arg + 1], repair_depth);
+        } else {
+            std::cerr << "Unknown argument " << argv[arg] << std::endl;
+            return EXIT_FAILURE;
+        }
+        if (!numeric) {
+            std::cerr << "Argument " << argv[arg] << " needs a non-negative number, not " << argv[arg + 1] << std::endl;
+            return EXIT_FAILURE;
+        }
+    }
 
     std::clock_t begin = clock();
+    auto wall_begin = std::chrono::steady_clock::now();
 
-    TSP::Instance<double,double> myTSP(file);
-    myTSP.compute_optimal_tour();
+    TSP::Instance<double,double> myTSP(file, distances);
+    myTSP.build_candidate_graph(candidates, num_candidates);
+    myTSP.set_step_rule(step_rule);
+    myTSP.set_bounding(bounding);
+    myTSP.set_memory_limit(memory_limit << 20);
+    myTSP.set_checkpoint(checkpoint, checkpoint_interval);
+    myTSP.set_resume_file(resume);
+    myTSP.set_heuristic(heuristic);
+    myTSP.set_tour_repair(repair_interval, repair_depth);
+    myTSP.compute_optimal_tour(num_threads);
     std::cout << myTSP.length() << std::endl;
     std::clock_t end = clock();
-    if(argc > 4){
-        myTSP.print_optimal_tour(argv[4]);
+    auto wall_end = std::chrono::steady_clock::now();
+    if(!solution.empty()){
+        myTSP.print_optimal_tour(solution);
     }
 
     double elapsed_secs = double(end - begin) / CLOCKS_PER_SEC;
-    std::cerr << "reading, initializing and computing the optimal tour took " << elapsed_secs << " s." << std::endl;
+    double wall_secs = std::chrono::duration<double>(wall_end - wall_begin).count();
+    std::cerr << "reading, initializing and computing the optimal tour took " << elapsed_secs << " s cpu time, "
+              << wall_secs << " s wall time." << std::endl;
     return EXIT_SUCCESS;
 }
-
-//Hello
\ No newline at end of file
@@ -0,0 +1,181 @@
+/**
+ * @file simd.cpp
+ *
+ * @brief relax and argmin kernels of the dense Prim algorithm. The AVX2 and AVX-512 versions are compiled
+ * via target attributes, everything else in this file only needs the x86-64 baseline.
+ */
+#include "../header/simd.hpp"
+
+#include <cstdlib>
+#include <string>
+#include <limits>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define TSP_SIMD_X86
+#include <immintrin.h>
+#endif
+
+namespace TSP {
+namespace simd {
+
+namespace {
+
+const double inf = std::numeric_limits<double>::infinity();
+
+/**
+ * the lanes of a vector kernel each hold their best key and its index. This picks the smallest key,
+ * ties are broken by the smaller index, and continues with the scalar tail [i, n)
+ */
+std::size_t reduce(const double *best_key, const double *best_idx, std::size_t lanes,
+                   const double *row, const double *offset, double *key,
+                   std::int64_t *parent, std::int64_t u, std::size_t i, std::size_t n) {
+    double min_key = inf;
+    std::size_t min_idx = n;
+    for (std::size_t lane = 0; lane < lanes; lane++) {
+        std::size_t idx = static_cast<std::size_t>(best_idx[lane]);
+        if (best_key[lane] < min_key || (best_key[lane] == min_key && idx < min_idx && min_key < inf)) {
+            min_key = best_key[lane];
+            min_idx = idx;
+        }
+    }
+    for (; i < n; i++) {
+        double w = row[i] + offset[i];
+        if (w < key[i]) {
+            key[i] = w;
+            parent[i] = u;
+        }
+        if (key[i] < min_key) {
+            min_key = key[i];
+            min_idx = i;
+        }
+    }
+    return min_idx;
+}
+
+std::size_t relax_argmin_scalar(const double *row, const double *offset, double *key,
+                                std::int64_t *parent, std::int64_t u, std::size_t n) {
+    return reduce(nullptr, nullptr, 0, row, offset, key, parent, u, 0, n);
+}
+
+#ifdef TSP_SIMD_X86
+
+std::size_t relax_argmin_sse2(const double *row, const double *offset, double *key,
+                              std::int64_t *parent, std::int64_t u, std::size_t n) {
+    __m128d best_key = _mm_set1_pd(inf), best_idx = _mm_set1_pd(0.);
+    __m128d idx = _mm_set_pd(1., 0.), step = _mm_set1_pd(2.);
+    __m128i from = _mm_set1_epi64x(u);
+    std::size_t i = 0;
+    for (; i + 2 <= n; i += 2) {
+        __m128d w = _mm_add_pd(_mm_loadu_pd(row + i), _mm_loadu_pd(offset + i));
+        __m128d k = _mm_loadu_pd(key + i);
+        __m128d less = _mm_cmplt_pd(w, k);
+        k = _mm_or_pd(_mm_and_pd(less, w), _mm_andnot_pd(less, k));
+        _mm_storeu_pd(key + i, k);
+        __m128i less_i = _mm_castpd_si128(less);
+        __m128i p = _mm_loadu_si128(reinterpret_cast<const __m128i *>(parent + i));
+        p = _mm_or_si128(_mm_and_si128(less_i, from), _mm_andnot_si128(less_i, p));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(parent + i), p);
+
+        __m128d better = _mm_cmplt_pd(k, best_key);
+        best_key = _mm_or_pd(_mm_and_pd(better, k), _mm_andnot_pd(better, best_key));
+        best_idx = _mm_or_pd(_mm_and_pd(better, idx), _mm_andnot_pd(better, best_idx));
+        idx = _mm_add_pd(idx, step);
+    }
+    double keys[2], idxs[2];
+    _mm_storeu_pd(keys, best_key);
+    _mm_storeu_pd(idxs, best_idx);
+    return reduce(keys, idxs, 2, row, offset, key, parent, u, i, n);
+}
+
+__attribute__((target("avx2")))
+std::size_t relax_argmin_avx2(const double *row, const double *offset, double *key,
+                              std::int64_t *parent, std::int64_t u, std::size_t n) {
+    __m256d best_key = _mm256_set1_pd(inf), best_idx = _mm256_set1_pd(0.);
+    __m256d idx = _mm256_set_pd(3., 2., 1., 0.), step = _mm256_set1_pd(4.);
+    __m256d from = _mm256_castsi256_pd(_mm256_set1_epi64x(u));
+    std::size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m256d w = _mm256_add_pd(_mm256_loadu_pd(row + i), _mm256_loadu_pd(offset + i));
+        __m256d k = _mm256_loadu_pd(key + i);
+        __m256d less = _mm256_cmp_pd(w, k, _CMP_LT_OQ);
+        k = _mm256_blendv_pd(k, w, less);
+        _mm256_storeu_pd(key + i, k);
+        double *p_addr = reinterpret_cast<double *>(parent + i);
+        _mm256_storeu_pd(p_addr, _mm256_blendv_pd(_mm256_loadu_pd(p_addr), from, less));
+
+        __m256d better = _mm256_cmp_pd(k, best_key, _CMP_LT_OQ);
+        best_key = _mm256_blendv_pd(best_key, k, better);
+        best_idx = _mm256_blendv_pd(best_idx, idx, better);
+        idx = _mm256_add_pd(idx, step);
+    }
+    double keys[4], idxs[4];
+    _mm256_storeu_pd(keys, best_key);
+    _mm256_storeu_pd(idxs, best_idx);
+    return reduce(keys, idxs, 4, row, offset, key, parent, u, i, n);
+}
+
+__attribute__((target("avx512f")))
+std::size_t relax_argmin_avx512(const double *row, const double *offset, double *key,
+                                std::int64_t *parent, std::int64_t u, std::size_t n) {
+    __m512d best_key = _mm512_set1_pd(inf), best_idx = _mm512_set1_pd(0.);
+    __m512d idx = _mm512_set_pd(7., 6., 5., 4., 3., 2., 1., 0.), step = _mm512_set1_pd(8.);
+    __m512i from = _mm512_set1_epi64(u);
+    std::size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m512d w = _mm512_add_pd(_mm512_loadu_pd(row + i), _mm512_loadu_pd(offset + i));
+        __m512d k = _mm512_loadu_pd(key + i);
+        __mmask8 less = _mm512_cmp_pd_mask(w, k, _CMP_LT_OQ);
+        k = _mm512_mask_mov_pd(k, less, w);
+        _mm512_mask_storeu_pd(key + i, less, w);
+        _mm512_mask_storeu_epi64(parent + i, less, from);
+
+        __mmask8 better = _mm512_cmp_pd_mask(k, best_key, _CMP_LT_OQ);
+        best_key = _mm512_mask_mov_pd(best_key, better, k);
+        best_idx = _mm512_mask_mov_pd(best_idx, better, idx);
+        idx = _mm512_add_pd(idx, step);
+    }
+    double keys[8], idxs[8];
+    _mm512_storeu_pd(keys, best_key);
+    _mm512_storeu_pd(idxs, best_idx);
+    return reduce(keys, idxs, 8, row, offset, key, parent, u, i, n);
+}
+
+#endif // TSP_SIMD_X86
+
+struct Choice {
+    RelaxArgminKernel kernel;
+    const char *name;
+};
+
+Choice select() {
+    const char *env = std::getenv("TSP_SIMD");
+    std::string wanted = env ? env : "";
+#ifdef TSP_SIMD_X86
+    __builtin_cpu_init();
+    if ((wanted.empty() || wanted == "avx512") && __builtin_cpu_supports("avx512f"))
+        return {relax_argmin_avx512, "avx512"};
+    if ((wanted.empty() || wanted == "avx512" || wanted == "avx2") && __builtin_cpu_supports("avx2"))
+        return {relax_argmin_avx2, "avx2"};
+    if (wanted != "scalar")
+        return {relax_argmin_sse2, "sse2"};
+#endif
+    return {relax_argmin_scalar, "scalar"};
+}
+
+const Choice &choice() {
+    static const Choice selected = select(); // thread-safe since C++11
+    return selected;
+}
+
+} // namespace
+
+RelaxArgminKernel relax_argmin_kernel() {
+    return choice().kernel;
+}
+
+const char *kernel_name() {
+    return choice().name;
+}
+
+} // namespace simd
+} // namespace TSP